@@ -1,63 +1,320 @@
 #include <iostream>
-#include <climits>
 #include <vector>
 #include <queue>
+#include <utility>
+#include <functional>
+#include <memory>
+#include <string>
+#include <ctime>
+#include <type_traits>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <fstream>
 
 using namespace std;
 
+// the first slab an ObjectPool allocates holds this many objects, and each later one
+// doubles up to the maximum
+const size_t FIRST_SLAB_SIZE = 32;
+const size_t MAX_SLAB_SIZE = 4096;
+
+// Hands out objects from slabs and recycles destroyed ones through a free list. The slabs
+// are released all at once when the pool is destroyed, without running any destructors,
+// so the owner must destroy whatever is still live first if that matters.
+template <typename T>
+class ObjectPool {
+    public:
+        ObjectPool() : freeList(nullptr), freeTail(nullptr), used(0), slabSize(0) {}
+
+        template <typename... Args>
+        T* create(Args&&... args);
+        void destroy(T* object);
+        // takes over every slab and free slot of other, leaving it empty
+        void adopt(ObjectPool& other);
+
+    private:
+        union Slot {
+            Slot* next;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            Slot() {}
+        };
+
+        vector<unique_ptr<Slot[]>> slabs;
+        Slot* freeList;
+        Slot* freeTail;
+        // slots handed out from the last slab
+        size_t used;
+        size_t slabSize;
+};
+
+template <typename T>
+template <typename... Args>
+T* ObjectPool<T>::create(Args&&... args) {
+    Slot* slot;
+    if (freeList) {
+        slot = freeList;
+        freeList = slot->next;
+        if (!freeList) {
+            freeTail = nullptr;
+        }
+    }
+    else {
+        if (used == slabSize) {
+            slabSize = slabSize ? min(slabSize * 2, MAX_SLAB_SIZE) : FIRST_SLAB_SIZE;
+            slabs.emplace_back(new Slot[slabSize]);
+            used = 0;
+        }
+        slot = &slabs.back()[used++];
+    }
+    return new (slot->storage) T(forward<Args>(args)...);
+}
+
+template <typename T>
+void ObjectPool<T>::destroy(T* object) {
+    object->~T();
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    slot->next = freeList;
+    freeList = slot;
+    if (!freeTail) {
+        freeTail = slot;
+    }
+}
+
+template <typename T>
+void ObjectPool<T>::adopt(ObjectPool& other) {
+    if (other.slabs.empty()) return;
+
+    if (slabs.empty()) {
+        slabs.swap(other.slabs);
+        used = other.used;
+        slabSize = other.slabSize;
+    }
+    else {
+        // our partly used slab has to stay last so that bumping carries on in it; whatever
+        // other never handed out of its last slab is simply left unused
+        size_t current = slabs.size() - 1;
+        for (unique_ptr<Slot[]>& slab : other.slabs) {
+            slabs.push_back(move(slab));
+        }
+        swap(slabs[current], slabs.back());
+        other.slabs.clear();
+    }
+
+    if (other.freeList) {
+        if (freeTail) {
+            freeTail->next = other.freeList;
+        }
+        else {
+            freeList = other.freeList;
+        }
+        freeTail = other.freeTail;
+    }
+    other.freeList = other.freeTail = nullptr;
+    other.used = other.slabSize = 0;
+}
+
+template <typename Key, typename Value>
+class Handle;
+
+template <typename Key, typename Value>
 class Node {
     public:
-        int key;
+        Key key;
         int order;
         Node* parent;
         Node* child;
         Node* sibling;
+        // the caller's locator for the element currently stored here
+        Handle<Key, Value>* handle;
 
-        Node(int k) : key(k), order(0), parent(nullptr), child(nullptr), sibling(nullptr) {}
+        Node(Key k) : key(move(k)), order(0), parent(nullptr), child(nullptr), sibling(nullptr), handle(nullptr) {}
 };
 
+// Returned by insert and owned by the heap until its element is extracted or erased.
+// decreaseKey moves keys between nodes, but the handle follows its element, so
+// decreaseKey and erase can find it again in O(1) without a search. The payload lives
+// here rather than in the node, so it never moves while the heap reorders itself.
+template <typename Key, typename Value>
+class Handle {
+    public:
+        Node<Key, Value>* node;
+        Value value;
+
+        Handle(Node<Key, Value>* n, Value v) : node(n), value(move(v)) {}
+        const Key& key() const { return node->key; }
+};
+
+// EAGER keeps the root list a proper binomial heap after every operation. LAZY lets
+// insert and unionHeaps just append to the root list in O(1), Fibonacci-heap style, and
+// leaves it to extractMin to link the roots back into one tree per order.
+enum ConsolidationMode { EAGER, LAZY };
+
+// A binomial heap ordered by Compare: less gives a min-heap, greater a max-heap. "Min"
+// in the method names means whichever element Compare puts first.
+template <typename Key, typename Value, typename Compare = less<Key>>
 class BinomialHeap {
     public:
-        Node* head;
+        typedef Node<Key, Value> HeapNode;
+        typedef Handle<Key, Value> HeapHandle;
+
+        HeapNode* head;
 
-        BinomialHeap() : head(nullptr) {}
+        BinomialHeap(ConsolidationMode mode = EAGER, const Compare& comp = Compare())
+            : head(nullptr), tail(nullptr), minRoot(nullptr), mode(mode), comp(comp) {}
+        ~BinomialHeap();
+        BinomialHeap(const BinomialHeap&) = delete;
+        BinomialHeap& operator=(const BinomialHeap&) = delete;
 
-        void insert(int key);
-        Node* search(int key);
-        Node* minimum();
-        void extractMin();
-        void decreaseKey(Node* node, int newKey);
-        void deleteNode(int key);
+        // Adds the (key, value) pairs in [first, last), moving out of them, in O(n): the
+        // new elements join the root list and are linked in one binary-counter pass. Their
+        // handles are appended to handles, in input order, if it is given.
+        template <typename Iterator>
+        void build(Iterator first, Iterator last, vector<HeapHandle*>* handles = nullptr);
+
+        HeapHandle* insert(Key key, Value value);
+        HeapHandle* search(const Key& key);
+        // O(1): the first root is cached and kept current by every operation
+        HeapHandle* minimum();
+        // removes the first element and hands back its key and payload
+        pair<Key, Value> extractMin();
+        // moves an element's key toward the front; a key that would move it back is ignored
+        void decreaseKey(HeapHandle* handle, Key newKey);
+        void erase(HeapHandle* handle);
+        void deleteNode(const Key& key);
+        // melds other into this heap, taking over its nodes and leaving it empty
         void unionHeaps(BinomialHeap* other);
-        void printTree(Node* root, int level);
+        bool empty() const { return head == nullptr; }
+        void printTree(HeapNode* root, int level);
         void printHeap();
     private:
-        Node* searchHelp(int key, Node* current);
+        // last root in the list, so LAZY appends and melds are O(1)
+        HeapNode* tail;
+        HeapNode* minRoot;
+        ConsolidationMode mode;
+        Compare comp;
+        // every node and handle is owned by these, so the heap is torn down a slab at a time
+        ObjectPool<HeapNode> nodePool;
+        ObjectPool<HeapHandle> handlePool;
+
+        HeapHandle* createElement(Key key, Value value);
+
+        HeapNode* searchHelp(const Key& key, HeapNode* current);
+        // rescans the root list for minRoot and tail
+        void refreshRoots();
+        void appendRoots(HeapNode* first, HeapNode* last);
+        // links roots of equal order until each order appears once, in increasing order
+        void consolidate();
+        // swaps the elements of node and its parent, keeping both handles pointing at them
+        void swapWithParent(HeapNode* node);
+        void removeRoot(HeapNode* root);
         // links two trees of the same order
-        void mergeTrees(Node* y, Node*);
-        Node* mergeRoots(Node* h1, Node* h2);
+        void mergeTrees(HeapNode* y, HeapNode* z);
+        HeapNode* mergeRoots(HeapNode* h1, HeapNode* h2);
 };
 
-void BinomialHeap::insert(int key) {
-    Node* newNode = new Node(key);
-    BinomialHeap newHeap;
-    newHeap.head = newNode;
+template <typename Key, typename Value, typename Compare>
+BinomialHeap<Key, Value, Compare>::~BinomialHeap() {
+    // trivially destructible elements need no walk; the pools free their slabs regardless
+    if (is_trivially_destructible<Key>::value && is_trivially_destructible<Value>::value) {
+        return;
+    }
 
-    unionHeaps(&newHeap);
+    vector<HeapNode*> pending;
+    if (head) {
+        pending.push_back(head);
+    }
+    while (!pending.empty()) {
+        HeapNode* node = pending.back();
+        pending.pop_back();
+        if (node->child) {
+            pending.push_back(node->child);
+        }
+        if (node->sibling) {
+            pending.push_back(node->sibling);
+        }
+        node->handle->~HeapHandle();
+        node->~HeapNode();
+    }
 }
 
-Node* BinomialHeap::search(int key) {
-    Node* current = head;
-    return searchHelp(key, current);
+template <typename Key, typename Value, typename Compare>
+Handle<Key, Value>* BinomialHeap<Key, Value, Compare>::createElement(Key key, Value value) {
+    HeapNode* node = nodePool.create(move(key));
+    HeapHandle* handle = handlePool.create(node, move(value));
+    node->handle = handle;
+    return handle;
 }
 
-Node* BinomialHeap::searchHelp(int key, Node* current) {
+template <typename Key, typename Value, typename Compare>
+template <typename Iterator>
+void BinomialHeap<Key, Value, Compare>::build(Iterator first, Iterator last, vector<HeapHandle*>* handles) {
+    for (; first != last; ++first) {
+        HeapHandle* handle = createElement(move(first->first), move(first->second));
+        appendRoots(handle->node, handle->node);
+        if (handles) {
+            handles->push_back(handle);
+        }
+    }
+
+    // a LAZY heap would only consolidate at the next extractMin anyway
+    if (mode == EAGER) {
+        consolidate();
+    }
+}
+
+template <typename Key, typename Value, typename Compare>
+Handle<Key, Value>* BinomialHeap<Key, Value, Compare>::insert(Key key, Value value) {
+    HeapHandle* handle = createElement(move(key), move(value));
+    HeapNode* newNode = handle->node;
+
+    if (mode == LAZY) {
+        appendRoots(newNode, newNode);
+        return handle;
+    }
+
+    // binary-counter increment: carry the new order-0 tree along the front of the list
+    newNode->sibling = head;
+    head = newNode;
+    while (head->sibling && head->sibling->order == head->order) {
+        HeapNode* first = head;
+        HeapNode* second = head->sibling;
+        if (comp(second->key, first->key)) {
+            mergeTrees(first, second);
+            head = second;
+        }
+        else {
+            first->sibling = second->sibling;
+            mergeTrees(second, first);
+        }
+    }
+    if (!head->sibling) {
+        tail = head;
+    }
+    // a cached minimum that was just linked under head cannot beat it
+    if (!minRoot || minRoot->parent || comp(head->key, minRoot->key)) {
+        minRoot = head;
+    }
+    return handle;
+}
+
+// O(n); only for callers that have lost a handle, such as the interactive demo
+template <typename Key, typename Value, typename Compare>
+Handle<Key, Value>* BinomialHeap<Key, Value, Compare>::search(const Key& key) {
+    HeapNode* found = searchHelp(key, head);
+    return found ? found->handle : nullptr;
+}
+
+template <typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinomialHeap<Key, Value, Compare>::searchHelp(const Key& key, HeapNode* current) {
     if (current) {
-        if (current->key == key) {
+        if (!comp(current->key, key) && !comp(key, current->key)) {
             return current;
         }
-        Node* child = searchHelp(key, current->child);
-        Node* sibling = searchHelp(key, current->sibling);
+        HeapNode* child = searchHelp(key, current->child);
+        HeapNode* sibling = searchHelp(key, current->sibling);
         if (child) {
             return child;
         }
@@ -68,101 +325,235 @@ Node* BinomialHeap::searchHelp(int key, Node* current) {
     return nullptr;
 }
 
-Node* BinomialHeap::minimum() {
-    if (!head) return nullptr;
+template <typename Key, typename Value, typename Compare>
+Handle<Key, Value>* BinomialHeap<Key, Value, Compare>::minimum() {
+    return minRoot ? minRoot->handle : nullptr;
+}
 
-    Node* minNode = head;
-    Node* current = head->sibling;
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::refreshRoots() {
+    minRoot = head;
+    tail = head;
+    if (!head) return;
 
+    HeapNode* current = head->sibling;
     while (current) {
-        if (current->key < minNode->key) {
-            minNode = current;
+        if (comp(current->key, minRoot->key)) {
+            minRoot = current;
         }
+        tail = current;
         current = current->sibling;
     }
+}
 
-    return minNode;
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::appendRoots(HeapNode* first, HeapNode* last) {
+    if (tail) {
+        tail->sibling = first;
+    }
+    else {
+        head = first;
+    }
+    tail = last;
+
+    for (HeapNode* current = first; current; current = current->sibling) {
+        if (!minRoot || comp(current->key, minRoot->key)) {
+            minRoot = current;
+        }
+        if (current == last) break;
+    }
 }
 
-void BinomialHeap::extractMin() {
-    Node* min = minimum();
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::consolidate() {
+    // orders never exceed log2(n), so one slot per bit of a size_t is enough
+    HeapNode* byOrder[64] = {};
 
-    if (head == min) {
+    HeapNode* current = head;
+    while (current) {
+        HeapNode* next = current->sibling;
+        current->sibling = nullptr;
+        while (byOrder[current->order]) {
+            HeapNode* other = byOrder[current->order];
+            byOrder[current->order] = nullptr;
+            if (comp(other->key, current->key)) {
+                swap(current, other);
+            }
+            mergeTrees(other, current);
+        }
+        byOrder[current->order] = current;
+        current = next;
+    }
+
+    head = tail = minRoot = nullptr;
+    for (HeapNode* root : byOrder) {
+        if (root) {
+            appendRoots(root, root);
+        }
+    }
+}
+
+// The heap must not be empty
+template <typename Key, typename Value, typename Compare>
+pair<Key, Value> BinomialHeap<Key, Value, Compare>::extractMin() {
+    HeapNode* min = minRoot;
+    pair<Key, Value> top(move(min->key), move(min->handle->value));
+    removeRoot(min);
+    return top;
+}
+
+// Unlinks a root, melds its children back in as a heap of their own, and frees it
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::removeRoot(HeapNode* root) {
+    if (head == root) {
         head = head->sibling;
     }
     else {
-        Node* prev = head;
+        HeapNode* prev = head;
 
-        while (prev->sibling != min) {
+        while (prev->sibling != root) {
             prev = prev->sibling;
         }
 
-        prev->sibling = min->sibling;
+        prev->sibling = root->sibling;
+    }
+    if (tail == root) {
+        tail = nullptr;
     }
-    min->sibling = nullptr;
+    root->sibling = nullptr;
 
-    BinomialHeap subtrees;
-    subtrees.head = min->child;
+    if (mode == LAZY) {
+        // the root list only has to be whole again, so the children can go on in any order
+        if (tail == nullptr) {
+            tail = head;
+            while (tail && tail->sibling) {
+                tail = tail->sibling;
+            }
+        }
+        minRoot = nullptr;
+        HeapNode* child = root->child;
+        while (child) {
+            HeapNode* next = child->sibling;
+            child->parent = nullptr;
+            child->sibling = nullptr;
+            appendRoots(child, child);
+            child = next;
+        }
+        consolidate();
 
-    vector<Node*> nodes;
-    Node* head = subtrees.head;
-    while (head) {
-        nodes.push_back(head);
-        head = head->sibling;
+        handlePool.destroy(root->handle);
+        nodePool.destroy(root);
+        return;
     }
 
-    subtrees.head = nodes[nodes.size()-1];
-
-    for (int i = nodes.size() - 1; i >= 1; i--) {
-        nodes[i]->sibling = nodes[i-1];
+    // children are kept in decreasing order, the root list in increasing order
+    BinomialHeap subtrees(EAGER, comp);
+    HeapNode* child = root->child;
+    while (child) {
+        HeapNode* next = child->sibling;
+        child->parent = nullptr;
+        child->sibling = subtrees.head;
+        subtrees.head = child;
+        child = next;
     }
-    nodes[0]->sibling = nullptr;
-    
-    unionHeaps(&subtrees);    
 
-    delete min;
+    unionHeaps(&subtrees);
+
+    handlePool.destroy(root->handle);
+    nodePool.destroy(root);
 }
 
-void BinomialHeap::decreaseKey(Node* node, int newKey) {
-    if (node) {
-        node->key = newKey;
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::swapWithParent(HeapNode* node) {
+    HeapNode* parent = node->parent;
+    swap(node->key, parent->key);
+    swap(node->handle, parent->handle);
+    node->handle->node = node;
+    parent->handle->node = parent;
+}
 
-        while (node->parent && node->key < node->parent->key) {
-            int k = node->key;
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::decreaseKey(HeapHandle* handle, Key newKey) {
+    if (!handle || comp(handle->key(), newKey)) {
+        return;
+    }
 
-            node->key = node->parent->key;
-            node->parent->key = k;
+    HeapNode* node = handle->node;
+    node->key = move(newKey);
 
-            node = node->parent;
-        }
+    while (node->parent && comp(node->key, node->parent->key)) {
+        swapWithParent(node);
+        node = node->parent;
+    }
+    if (!node->parent && comp(node->key, minRoot->key)) {
+        minRoot = node;
     }
 }
 
-void BinomialHeap::deleteNode(int key) {
-    Node* node = search(key);
-    if (node) {
-        decreaseKey(node, INT_MIN);
-        extractMin();
+// Carries the element all the way up to its root, regardless of keys, then removes that
+// root. No sentinel key is needed, so every key stays usable.
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::erase(HeapHandle* handle) {
+    HeapNode* node = handle->node;
+    while (node->parent) {
+        swapWithParent(node);
+        node = node->parent;
     }
+    removeRoot(node);
 }
 
-void BinomialHeap::unionHeaps(BinomialHeap* other) {
-    Node* newHead = mergeRoots(this->head, other->head);
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::deleteNode(const Key& key) {
+    HeapHandle* handle = search(key);
+    if (handle) {
+        erase(handle);
+    }
+}
+
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::unionHeaps(BinomialHeap* other) {
+    nodePool.adopt(other->nodePool);
+    handlePool.adopt(other->handlePool);
+
+    if (mode == LAZY) {
+        if (other->head) {
+            if (tail) {
+                tail->sibling = other->head;
+            }
+            else {
+                head = other->head;
+            }
+            tail = other->tail;
+            if (!minRoot || comp(other->minRoot->key, minRoot->key)) {
+                minRoot = other->minRoot;
+            }
+        }
+        other->head = other->tail = other->minRoot = nullptr;
+        return;
+    }
+    if (other->mode == LAZY) {
+        other->consolidate();
+    }
+
+    HeapNode* newHead = mergeRoots(this->head, other->head);
     this->head = nullptr;
-    other->head = nullptr;
+    other->head = other->tail = other->minRoot = nullptr;
 
-    if(!newHead) return;
+    if(!newHead) {
+        refreshRoots();
+        return;
+    }
 
-    Node* prev = nullptr;
-    Node* curr = newHead;
-    Node* next = curr->sibling;
+    HeapNode* prev = nullptr;
+    HeapNode* curr = newHead;
+    HeapNode* next = curr->sibling;
 
     while (next) {
         if ((curr->order != next->order) || (next->sibling && next->sibling->order == curr->order)) {
             prev = curr;
             curr = next;
         }
-        else if (curr->key <= next->key) {
+        else if (!comp(next->key, curr->key)) {
             curr->sibling = next->sibling;
             mergeTrees(next, curr);
         }
@@ -179,13 +570,15 @@ void BinomialHeap::unionHeaps(BinomialHeap* other) {
     }
 
     this->head = newHead;
+    refreshRoots();
 }
 
-void BinomialHeap::printTree(Node* root, int level = 0) {
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::printTree(HeapNode* root, int level) {
     if (!root) return;
 
     // Create a queue to hold nodes and their corresponding levels and indentation strings
-    queue<pair<Node*, string>> nodeQueue;
+    queue<pair<HeapNode*, string>> nodeQueue;
     nodeQueue.push({root, ""}); // Root node with no indentation
 
     while (!nodeQueue.empty()) {
@@ -197,7 +590,7 @@ void BinomialHeap::printTree(Node* root, int level = 0) {
 
         // Add child nodes with appropriate indentation
         if (node->child) {
-            Node* child = node->child;
+            HeapNode* child = node->child;
             string childIndent = indent + "    "; // Indent further for child nodes
 
             while (child) {
@@ -208,31 +601,33 @@ void BinomialHeap::printTree(Node* root, int level = 0) {
     }
 }
 
-void BinomialHeap::printHeap() {
-    Node* current = head;
-    int treeIndex = 1;
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::printHeap() {
+    HeapNode* current = head;
 
     // Traverse each tree in the root list
     while (current) {
-        printTree(current);  // Print each binomial tree starting from the root node
+        printTree(current, 0);  // Print each binomial tree starting from the root node
         current = current->sibling;
         cout << endl; // Separate each tree with a new line for clarity
     }
 }
 
-void BinomialHeap::mergeTrees(Node* y, Node* z) {
+template <typename Key, typename Value, typename Compare>
+void BinomialHeap<Key, Value, Compare>::mergeTrees(HeapNode* y, HeapNode* z) {
     y->parent = z;
     y->sibling = z->child;
     z->child = y;
     z->order++;
 }
 
-Node* BinomialHeap::mergeRoots(Node* h2, Node* h1) {
+template <typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinomialHeap<Key, Value, Compare>::mergeRoots(HeapNode* h2, HeapNode* h1) {
     if (!h1) return h2;
     if (!h2) return h1;
 
-    Node* head = nullptr;
-    Node* tail = nullptr;
+    HeapNode* head = nullptr;
+    HeapNode* tail = nullptr;
 
     if (h1->order <= h2->order) {
         head = h1;
@@ -259,14 +654,661 @@ Node* BinomialHeap::mergeRoots(Node* h2, Node* h1) {
     return head;
 }
 
-void loadArrayIntoBinomialHeap(const vector<int>& arr, BinomialHeap* heap) {
-    for (int num : arr) {
-        cout << "Inserting " << num << " into the heap." << endl;
-        heap->insert(num);
+// An element's position in an array-based heap: the key sits in the array next to the
+// handle, so sifting and bucketing compare keys without leaving the array.
+template <typename Key, typename HandleType>
+class HeapSlot {
+    public:
+        Key key;
+        HandleType* handle;
+};
+
+// Stable locator for an element of a DaryHeap; index follows the element as it is sifted
+template <typename Key, typename Value>
+class DaryHandle {
+    public:
+        size_t index;
+        const vector<HeapSlot<Key, DaryHandle>>* slots;
+        Value value;
+
+        DaryHandle(const vector<HeapSlot<Key, DaryHandle>>* slots, Value v) : index(0), slots(slots), value(move(v)) {}
+        const Key& key() const { return (*slots)[index].key; }
+};
+
+// An implicit heap in which every node has Arity children, stored level by level in one
+// array. More children make the tree shallower and keep a sift-down within a few cache
+// lines, at the cost of more comparisons per level; 4 is usually the sweet spot.
+template <typename Key, typename Value, unsigned Arity = 4, typename Compare = less<Key>>
+class DaryHeap {
+    public:
+        typedef DaryHandle<Key, Value> HeapHandle;
+        typedef HeapSlot<Key, HeapHandle> Slot;
+
+        DaryHeap(const Compare& comp = Compare()) : comp(comp) {}
+        ~DaryHeap();
+        DaryHeap(const DaryHeap&) = delete;
+        DaryHeap& operator=(const DaryHeap&) = delete;
+
+        HeapHandle* insert(Key key, Value value);
+        HeapHandle* minimum() { return slots.empty() ? nullptr : slots[0].handle; }
+        pair<Key, Value> extractMin();
+        void decreaseKey(HeapHandle* handle, Key newKey);
+        void erase(HeapHandle* handle);
+        // O(n + m): appends other's array and re-heapifies, unless other is small enough
+        // that sifting its elements up one at a time is cheaper
+        void unionHeaps(DaryHeap* other);
+        bool empty() const { return slots.empty(); }
+    private:
+        vector<Slot> slots;
+        ObjectPool<HeapHandle> handlePool;
+        Compare comp;
+
+        // both return the index the slot ends up at
+        size_t siftUp(size_t index);
+        size_t siftDown(size_t index);
+        // fills the hole at index with the last slot
+        void removeAt(size_t index);
+};
+
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+DaryHeap<Key, Value, Arity, Compare>::~DaryHeap() {
+    if (!is_trivially_destructible<Value>::value) {
+        for (Slot& slot : slots) {
+            slot.handle->~HeapHandle();
+        }
+    }
+}
+
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+size_t DaryHeap<Key, Value, Arity, Compare>::siftUp(size_t index) {
+    Slot moving = move(slots[index]);
+    while (index > 0) {
+        size_t parent = (index - 1) / Arity;
+        if (!comp(moving.key, slots[parent].key)) break;
+        slots[index] = move(slots[parent]);
+        slots[index].handle->index = index;
+        index = parent;
+    }
+    slots[index] = move(moving);
+    slots[index].handle->index = index;
+    return index;
+}
+
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+size_t DaryHeap<Key, Value, Arity, Compare>::siftDown(size_t index) {
+    size_t count = slots.size();
+    Slot moving = move(slots[index]);
+    while (true) {
+        size_t first = index * Arity + 1;
+        if (first >= count) break;
+        size_t last = min(first + Arity, count);
+        size_t best = first;
+        for (size_t child = first + 1; child < last; ++child) {
+            if (comp(slots[child].key, slots[best].key)) {
+                best = child;
+            }
+        }
+        if (!comp(slots[best].key, moving.key)) break;
+        slots[index] = move(slots[best]);
+        slots[index].handle->index = index;
+        index = best;
+    }
+    slots[index] = move(moving);
+    slots[index].handle->index = index;
+    return index;
+}
+
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+DaryHandle<Key, Value>* DaryHeap<Key, Value, Arity, Compare>::insert(Key key, Value value) {
+    HeapHandle* handle = handlePool.create(&slots, move(value));
+    slots.push_back(Slot{move(key), handle});
+    siftUp(slots.size() - 1);
+    return handle;
+}
+
+// The heap must not be empty
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+pair<Key, Value> DaryHeap<Key, Value, Arity, Compare>::extractMin() {
+    HeapHandle* top = slots[0].handle;
+    pair<Key, Value> element(move(slots[0].key), move(top->value));
+    handlePool.destroy(top);
+    removeAt(0);
+    return element;
+}
+
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+void DaryHeap<Key, Value, Arity, Compare>::removeAt(size_t index) {
+    if (index + 1 < slots.size()) {
+        slots[index] = move(slots.back());
+        slots.pop_back();
+        if (siftUp(index) == index) {
+            siftDown(index);
+        }
+    }
+    else {
+        slots.pop_back();
+    }
+}
+
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+void DaryHeap<Key, Value, Arity, Compare>::decreaseKey(HeapHandle* handle, Key newKey) {
+    if (!handle || comp(handle->key(), newKey)) {
+        return;
+    }
+    slots[handle->index].key = move(newKey);
+    siftUp(handle->index);
+}
+
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+void DaryHeap<Key, Value, Arity, Compare>::erase(HeapHandle* handle) {
+    size_t index = handle->index;
+    handlePool.destroy(handle);
+    removeAt(index);
+}
+
+template <typename Key, typename Value, unsigned Arity, typename Compare>
+void DaryHeap<Key, Value, Arity, Compare>::unionHeaps(DaryHeap* other) {
+    handlePool.adopt(other->handlePool);
+
+    size_t start = slots.size();
+    for (Slot& slot : other->slots) {
+        slot.handle->slots = &slots;
+        slot.handle->index = slots.size();
+        slots.push_back(move(slot));
+    }
+    other->slots.clear();
+
+    size_t added = slots.size() - start;
+    if (added * 8 < slots.size()) {
+        for (size_t i = start; i < slots.size(); ++i) {
+            siftUp(i);
+        }
+    }
+    else if (slots.size() > 1) {
+        for (size_t i = (slots.size() - 2) / Arity + 1; i-- > 0;) {
+            siftDown(i);
+        }
+    }
+}
+
+// Stable locator for an element of a RadixHeap: the bucket it is in and its place there
+template <typename Key, typename Value>
+class RadixHandle {
+    public:
+        unsigned bucket;
+        size_t index;
+        const vector<HeapSlot<Key, RadixHandle>>* buckets;
+        Value value;
+
+        RadixHandle(const vector<HeapSlot<Key, RadixHandle>>* buckets, Value v) : bucket(0), index(0), buckets(buckets), value(move(v)) {}
+        const Key& key() const { return buckets[bucket][index].key; }
+};
+
+// A min-heap for unsigned integer keys that never go below the last key extracted, which
+// is what Dijkstra produces. Bucket 0 holds keys equal to the last extracted one, and
+// bucket b the keys whose highest bit differing from it is bit b - 1. extractMin only
+// redistributes the first non-empty bucket, and a key can only move to lower buckets, so
+// each key is moved at most once per bit. Inserting or decreasing to a key below the last
+// extracted one is not allowed.
+template <typename Key, typename Value>
+class RadixHeap {
+    static_assert(is_unsigned<Key>::value, "RadixHeap needs unsigned integer keys");
+
+    public:
+        typedef RadixHandle<Key, Value> HeapHandle;
+        typedef HeapSlot<Key, HeapHandle> Slot;
+        static const unsigned BUCKETS = numeric_limits<Key>::digits + 1;
+
+        RadixHeap() : last(0), count(0) {}
+        ~RadixHeap();
+        RadixHeap(const RadixHeap&) = delete;
+        RadixHeap& operator=(const RadixHeap&) = delete;
+
+        HeapHandle* insert(Key key, Value value);
+        // scans the first non-empty bucket, which is O(1) while keys equal to the last
+        // extracted one remain
+        HeapHandle* minimum();
+        pair<Key, Value> extractMin();
+        void decreaseKey(HeapHandle* handle, Key newKey);
+        void erase(HeapHandle* handle);
+        // O(m): reinserts other's elements, which must not be below this heap's last key
+        void unionHeaps(RadixHeap* other);
+        bool empty() const { return count == 0; }
+    private:
+        vector<Slot> buckets[BUCKETS];
+        ObjectPool<HeapHandle> handlePool;
+        Key last;
+        size_t count;
+
+        unsigned bucketFor(Key key) const;
+        void place(Slot slot);
+        // removes the slot at index from its bucket, filling the hole with the bucket's last
+        void removeAt(unsigned bucket, size_t index);
+        // makes bucket 0 non-empty by advancing last to the current minimum
+        void redistribute();
+};
+
+template <typename Key, typename Value>
+RadixHeap<Key, Value>::~RadixHeap() {
+    if (!is_trivially_destructible<Value>::value) {
+        for (vector<Slot>& bucket : buckets) {
+            for (Slot& slot : bucket) {
+                slot.handle->~HeapHandle();
+            }
+        }
+    }
+}
+
+template <typename Key, typename Value>
+unsigned RadixHeap<Key, Value>::bucketFor(Key key) const {
+    unsigned long long diff = static_cast<unsigned long long>(key ^ last);
+    return diff == 0 ? 0 : 64 - __builtin_clzll(diff);
+}
+
+template <typename Key, typename Value>
+void RadixHeap<Key, Value>::place(Slot slot) {
+    unsigned bucket = bucketFor(slot.key);
+    slot.handle->bucket = bucket;
+    slot.handle->index = buckets[bucket].size();
+    buckets[bucket].push_back(move(slot));
+}
+
+template <typename Key, typename Value>
+void RadixHeap<Key, Value>::removeAt(unsigned bucket, size_t index) {
+    vector<Slot>& slots = buckets[bucket];
+    if (index + 1 < slots.size()) {
+        slots[index] = move(slots.back());
+        slots[index].handle->index = index;
     }
+    slots.pop_back();
 }
 
-int main() {
+template <typename Key, typename Value>
+RadixHandle<Key, Value>* RadixHeap<Key, Value>::insert(Key key, Value value) {
+    HeapHandle* handle = handlePool.create(buckets, move(value));
+    place(Slot{key, handle});
+    count++;
+    return handle;
+}
+
+template <typename Key, typename Value>
+void RadixHeap<Key, Value>::redistribute() {
+    unsigned bucket = 1;
+    while (buckets[bucket].empty()) {
+        bucket++;
+    }
+
+    Key newLast = buckets[bucket][0].key;
+    for (const Slot& slot : buckets[bucket]) {
+        newLast = min(newLast, slot.key);
+    }
+    last = newLast;
+
+    // swap out first, since place may push onto any lower bucket
+    vector<Slot> moving;
+    moving.swap(buckets[bucket]);
+    for (Slot& slot : moving) {
+        place(move(slot));
+    }
+    // hand the capacity back so the bucket does not reallocate next time round
+    moving.clear();
+    buckets[bucket].swap(moving);
+}
+
+template <typename Key, typename Value>
+RadixHandle<Key, Value>* RadixHeap<Key, Value>::minimum() {
+    if (count == 0) return nullptr;
+
+    // scanning rather than redistributing leaves last alone, so it stays legal to insert
+    // keys between the last extracted one and the minimum
+    unsigned bucket = 0;
+    while (buckets[bucket].empty()) {
+        bucket++;
+    }
+    const Slot* best = &buckets[bucket][0];
+    for (const Slot& slot : buckets[bucket]) {
+        if (slot.key < best->key) {
+            best = &slot;
+        }
+    }
+    return best->handle;
+}
+
+// The heap must not be empty
+template <typename Key, typename Value>
+pair<Key, Value> RadixHeap<Key, Value>::extractMin() {
+    if (buckets[0].empty()) {
+        redistribute();
+    }
+    Slot& slot = buckets[0].back();
+    pair<Key, Value> element(slot.key, move(slot.handle->value));
+    handlePool.destroy(slot.handle);
+    buckets[0].pop_back();
+    count--;
+    return element;
+}
+
+template <typename Key, typename Value>
+void RadixHeap<Key, Value>::decreaseKey(HeapHandle* handle, Key newKey) {
+    if (!handle || newKey >= handle->key()) {
+        return;
+    }
+    removeAt(handle->bucket, handle->index);
+    place(Slot{newKey, handle});
+}
+
+template <typename Key, typename Value>
+void RadixHeap<Key, Value>::erase(HeapHandle* handle) {
+    removeAt(handle->bucket, handle->index);
+    handlePool.destroy(handle);
+    count--;
+}
+
+template <typename Key, typename Value>
+void RadixHeap<Key, Value>::unionHeaps(RadixHeap* other) {
+    handlePool.adopt(other->handlePool);
+    for (vector<Slot>& bucket : other->buckets) {
+        for (Slot& slot : bucket) {
+            slot.handle->buckets = buckets;
+            place(move(slot));
+        }
+        bucket.clear();
+    }
+    count += other->count;
+    other->count = 0;
+}
+
+// A pairing heap node is its own handle: nodes are only ever relinked, never swapped
+template <typename Key, typename Value>
+class PairingNode {
+    public:
+        Key priority;
+        Value value;
+        PairingNode* child;
+        PairingNode* next;
+        // the previous sibling, or the parent for a first child
+        PairingNode* prev;
+
+        PairingNode(Key k, Value v) : priority(move(k)), value(move(v)), child(nullptr), next(nullptr), prev(nullptr) {}
+        const Key& key() const { return priority; }
+};
+
+// A single heap-ordered tree of any shape. Insert, meld and decreaseKey are O(1) links;
+// extractMin pays for them by merging the root's children in two passes, which keeps the
+// amortized cost at O(log n).
+template <typename Key, typename Value, typename Compare = less<Key>>
+class PairingHeap {
+    public:
+        typedef PairingNode<Key, Value> HeapHandle;
+
+        PairingHeap(const Compare& comp = Compare()) : root(nullptr), comp(comp) {}
+        ~PairingHeap();
+        PairingHeap(const PairingHeap&) = delete;
+        PairingHeap& operator=(const PairingHeap&) = delete;
+
+        HeapHandle* insert(Key key, Value value);
+        HeapHandle* minimum() { return root; }
+        pair<Key, Value> extractMin();
+        void decreaseKey(HeapHandle* handle, Key newKey);
+        void erase(HeapHandle* handle);
+        void unionHeaps(PairingHeap* other);
+        bool empty() const { return root == nullptr; }
+    private:
+        HeapHandle* root;
+        ObjectPool<HeapHandle> nodePool;
+        Compare comp;
+
+        // makes the later of two roots the first child of the other and returns the survivor
+        HeapHandle* link(HeapHandle* a, HeapHandle* b);
+        // detaches a subtree from its parent and siblings
+        void cut(HeapHandle* node);
+        // links a list of siblings into one tree: pairs left to right, then folds right to left
+        HeapHandle* mergePairs(HeapHandle* first);
+};
+
+template <typename Key, typename Value, typename Compare>
+PairingHeap<Key, Value, Compare>::~PairingHeap() {
+    if (is_trivially_destructible<Key>::value && is_trivially_destructible<Value>::value) {
+        return;
+    }
+
+    vector<HeapHandle*> pending;
+    if (root) {
+        pending.push_back(root);
+    }
+    while (!pending.empty()) {
+        HeapHandle* node = pending.back();
+        pending.pop_back();
+        if (node->child) {
+            pending.push_back(node->child);
+        }
+        if (node->next) {
+            pending.push_back(node->next);
+        }
+        node->~HeapHandle();
+    }
+}
+
+template <typename Key, typename Value, typename Compare>
+PairingNode<Key, Value>* PairingHeap<Key, Value, Compare>::link(HeapHandle* a, HeapHandle* b) {
+    if (comp(b->priority, a->priority)) {
+        swap(a, b);
+    }
+    b->prev = a;
+    b->next = a->child;
+    if (a->child) {
+        a->child->prev = b;
+    }
+    a->child = b;
+    return a;
+}
+
+template <typename Key, typename Value, typename Compare>
+void PairingHeap<Key, Value, Compare>::cut(HeapHandle* node) {
+    if (node->prev->child == node) {
+        node->prev->child = node->next;
+    }
+    else {
+        node->prev->next = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
+    node->next = node->prev = nullptr;
+}
+
+template <typename Key, typename Value, typename Compare>
+PairingNode<Key, Value>* PairingHeap<Key, Value, Compare>::mergePairs(HeapHandle* first) {
+    if (!first) return nullptr;
+
+    // first pass: link neighbours pairwise, stacking the results through next
+    HeapHandle* pairs = nullptr;
+    while (first) {
+        HeapHandle* a = first;
+        HeapHandle* b = a->next;
+        first = b ? b->next : nullptr;
+
+        a->next = a->prev = nullptr;
+        if (b) {
+            b->next = b->prev = nullptr;
+            a = link(a, b);
+        }
+        a->next = pairs;
+        pairs = a;
+    }
+
+    // second pass: the stack holds the pairs right to left, so fold it in that order
+    HeapHandle* result = pairs;
+    pairs = pairs->next;
+    result->next = nullptr;
+    while (pairs) {
+        HeapHandle* following = pairs->next;
+        pairs->next = nullptr;
+        result = link(result, pairs);
+        pairs = following;
+    }
+    return result;
+}
+
+template <typename Key, typename Value, typename Compare>
+PairingNode<Key, Value>* PairingHeap<Key, Value, Compare>::insert(Key key, Value value) {
+    HeapHandle* node = nodePool.create(move(key), move(value));
+    root = root ? link(root, node) : node;
+    return node;
+}
+
+// The heap must not be empty
+template <typename Key, typename Value, typename Compare>
+pair<Key, Value> PairingHeap<Key, Value, Compare>::extractMin() {
+    HeapHandle* top = root;
+    pair<Key, Value> element(move(top->priority), move(top->value));
+    root = mergePairs(top->child);
+    nodePool.destroy(top);
+    return element;
+}
+
+template <typename Key, typename Value, typename Compare>
+void PairingHeap<Key, Value, Compare>::decreaseKey(HeapHandle* handle, Key newKey) {
+    if (!handle || comp(handle->priority, newKey)) {
+        return;
+    }
+    handle->priority = move(newKey);
+    if (handle != root) {
+        cut(handle);
+        root = link(root, handle);
+    }
+}
+
+template <typename Key, typename Value, typename Compare>
+void PairingHeap<Key, Value, Compare>::erase(HeapHandle* handle) {
+    if (handle == root) {
+        root = mergePairs(root->child);
+    }
+    else {
+        cut(handle);
+        HeapHandle* subtree = mergePairs(handle->child);
+        if (subtree) {
+            root = link(root, subtree);
+        }
+    }
+    nodePool.destroy(handle);
+}
+
+template <typename Key, typename Value, typename Compare>
+void PairingHeap<Key, Value, Compare>::unionHeaps(PairingHeap* other) {
+    nodePool.adopt(other->nodePool);
+    if (other->root) {
+        root = root ? link(root, other->root) : other->root;
+    }
+    other->root = nullptr;
+}
+
+// Average time per operation over count operations, in nanoseconds
+template <typename Operation>
+double nanosPerOp(size_t count, Operation op) {
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        op(i);
+    }
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / count;
+}
+
+// Runs one heap through a Dijkstra-like mix and writes a CSV row: n inserts, n / 2
+// decreaseKeys on random elements, n extractMins, and the melds of MELD_PIECES heaps of
+// n / MELD_PIECES keys each into one.
+const size_t MELD_PIECES = 64;
+
+template <typename Heap, typename Factory>
+void benchmarkHeap(ostream& out, const string& name, const vector<unsigned>& keys, const vector<size_t>& picks, Factory makeHeap) {
+    unsigned long long sink = 0;
+    size_t keyCount = keys.size();
+
+    unique_ptr<Heap> heap(makeHeap());
+    vector<typename Heap::HeapHandle*> handles(keyCount);
+    double insertNs = nanosPerOp(keyCount, [&](size_t i) { handles[i] = heap->insert(keys[i], static_cast<unsigned>(i)); });
+    double decreaseNs = nanosPerOp(picks.size(), [&](size_t i) {
+        typename Heap::HeapHandle* handle = handles[picks[i]];
+        heap->decreaseKey(handle, handle->key() / 2);
+    });
+    double extractNs = nanosPerOp(keyCount, [&](size_t) { sink += heap->extractMin().first; });
+
+    vector<unique_ptr<Heap>> pieces(MELD_PIECES);
+    for (size_t piece = 0; piece < MELD_PIECES; ++piece) {
+        pieces[piece].reset(makeHeap());
+        for (size_t i = piece; i < keyCount; i += MELD_PIECES) {
+            pieces[piece]->insert(keys[i], static_cast<unsigned>(i));
+        }
+    }
+    double meldNs = nanosPerOp(MELD_PIECES - 1, [&](size_t i) { pieces[0]->unionHeaps(pieces[i + 1].get()); });
+    sink += pieces[0]->minimum()->key();
+
+    out << name << "," << keyCount << "," << insertNs << "," << decreaseNs << "," << extractNs << "," << meldNs << endl;
+    volatile unsigned long long keepSink = sink;
+    (void)keepSink;
+}
+
+// Compares the heaps on random keys and writes one CSV row per heap and size
+void runBenchmarks(ostream& out) {
+    mt19937 gen(5800);
+    const size_t keyCounts[] = {1000, 10000, 100000, 1000000};
+
+    out << "heap,key_count,insert_ns,decrease_key_ns,extract_min_ns,meld_ns" << endl;
+
+    for (size_t keyCount : keyCounts) {
+        vector<unsigned> keys(keyCount);
+        for (unsigned& key : keys) {
+            key = gen() >> 2;
+        }
+        vector<size_t> picks(keyCount / 2);
+        for (size_t& pick : picks) {
+            pick = gen() % keyCount;
+        }
+
+        benchmarkHeap<BinomialHeap<unsigned, unsigned>>(out, "binomial", keys, picks, [] { return new BinomialHeap<unsigned, unsigned>(EAGER); });
+        benchmarkHeap<BinomialHeap<unsigned, unsigned>>(out, "binomial_lazy", keys, picks, [] { return new BinomialHeap<unsigned, unsigned>(LAZY); });
+        benchmarkHeap<DaryHeap<unsigned, unsigned, 2>>(out, "dary_2", keys, picks, [] { return new DaryHeap<unsigned, unsigned, 2>(); });
+        benchmarkHeap<DaryHeap<unsigned, unsigned, 4>>(out, "dary_4", keys, picks, [] { return new DaryHeap<unsigned, unsigned, 4>(); });
+        benchmarkHeap<DaryHeap<unsigned, unsigned, 8>>(out, "dary_8", keys, picks, [] { return new DaryHeap<unsigned, unsigned, 8>(); });
+        benchmarkHeap<RadixHeap<unsigned, unsigned>>(out, "radix", keys, picks, [] { return new RadixHeap<unsigned, unsigned>(); });
+        benchmarkHeap<PairingHeap<unsigned, unsigned>>(out, "pairing", keys, picks, [] { return new PairingHeap<unsigned, unsigned>(); });
+    }
+}
+
+// The demo heap keeps each key's insertion number as its payload
+typedef BinomialHeap<int, int> DemoHeap;
+
+void loadArrayIntoBinomialHeap(const vector<int>& arr, DemoHeap* heap) {
+    vector<pair<int, int>> elements;
+    elements.reserve(arr.size());
+    for (size_t i = 0; i < arr.size(); ++i) {
+        elements.push_back({arr[i], static_cast<int>(i) + 1});
+    }
+    heap->build(elements.begin(), elements.end());
+    cout << "Loaded " << arr.size() << " keys into the heap." << endl;
+}
+
+// Empties any of the heaps, printing the keys as they come out
+template <typename Heap>
+void printInOrder(const string& name, Heap& heap) {
+    cout << name << " in order:";
+    while (!heap.empty()) {
+        cout << " " << heap.extractMin().first;
+    }
+    cout << endl;
+}
+
+int main(int argc, char* argv[]) {
+    // BinomialHeap --bench [results.csv] compares the heaps instead of running the demo
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        if (argc > 2) {
+            ofstream results(argv[2]);
+            runBenchmarks(results);
+        } else {
+            runBenchmarks(cout);
+        }
+        return 0;
+    }
+
     int m;
     cout << "Enter the number of elements to test: ";
     cin >> m;
@@ -280,7 +1322,7 @@ int main() {
     }
 
     // Create a new binomial heap
-    BinomialHeap heap;
+    DemoHeap heap;
 
     // Load the array into the binomial heap
     loadArrayIntoBinomialHeap(arr, &heap);
@@ -289,6 +1331,35 @@ int main() {
     cout << "\nHeap after all insertions:" << endl;
     heap.printHeap();
 
+    // a max-heap of jobs: highest priority first, each carrying a move-only payload
+    BinomialHeap<int, unique_ptr<string>, greater<int>> jobs;
+    jobs.insert(2, unique_ptr<string>(new string("rebuild index")));
+    jobs.insert(9, unique_ptr<string>(new string("page on-call")));
+    jobs.insert(5, unique_ptr<string>(new string("rotate logs")));
+    cout << "Jobs by priority:";
+    while (!jobs.empty()) {
+        pair<int, unique_ptr<string>> job = jobs.extractMin();
+        cout << " " << job.first << "=" << *job.second;
+    }
+    cout << endl;
+
+    // the same keys through a lazy heap, where inserts only append and the first extract
+    // consolidates, and through the array-based and pairing alternatives
+    DemoHeap lazyHeap(LAZY);
+    DaryHeap<int, int> daryHeap;
+    RadixHeap<unsigned, int> radixHeap;
+    PairingHeap<int, int> pairingHeap;
+    for (size_t i = 0; i < arr.size(); ++i) {
+        lazyHeap.insert(arr[i], static_cast<int>(i) + 1);
+        daryHeap.insert(arr[i], static_cast<int>(i) + 1);
+        radixHeap.insert(arr[i], static_cast<int>(i) + 1);
+        pairingHeap.insert(arr[i], static_cast<int>(i) + 1);
+    }
+    printInOrder("Lazy heap", lazyHeap);
+    printInOrder("4-ary heap", daryHeap);
+    printInOrder("Radix heap", radixHeap);
+    printInOrder("Pairing heap", pairingHeap);
+
     bool running = true;
 
     while (running) {
@@ -300,17 +1371,21 @@ int main() {
             int key;
             cout << "Enter the key to insert: ";
             cin >> key;
-            heap.insert(key);
+            heap.insert(key, static_cast<int>(arr.size()) + 1);
+            arr.push_back(key);
             heap.printHeap();
         }
         else if (command == "Minimum") {
-            Node* min = heap.minimum();
-            if (min) cout << "Minimum key: " << min->key << endl;
+            DemoHeap::HeapHandle* min = heap.minimum();
+            if (min) cout << "Minimum key: " << min->key() << " (insert #" << min->value << ")" << endl;
             else cout << "Heap is empty." << endl;
         }
         else if (command == "ExtractMin") {
-            heap.extractMin();
-            cout << "Minimum element extracted." << endl;
+            if (!heap.empty()) {
+                heap.extractMin();
+                cout << "Minimum element extracted." << endl;
+            }
+            else cout << "Heap is empty." << endl;
             heap.printHeap();
         }
         else if (command == "DecreaseKey") {
@@ -338,4 +1413,4 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -8,231 +8,444 @@
 #include <fstream>
 #include <sstream>
 #include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HASH_TABLE_X86 1
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
+// keys up to this many bytes are stored inside their node, longer ones in the table's StringArena
+const uint32_t INLINE_KEY_LENGTH = 20;
+
+// nodes per slab in a NodePool, and bytes per block in a StringArena
+const size_t NODES_PER_SLAB = 1024;
+const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
 class Node {
     public:
-        string key;
-        int value;
         Node* next;
+        uint32_t hash;
+        int value;
+        uint32_t keyLength;
+        // the key itself if it fits, otherwise the address of its bytes in the StringArena
+        char keyBytes[INLINE_KEY_LENGTH];
+
+        string_view key() const {
+            if (keyLength <= INLINE_KEY_LENGTH) {
+                return string_view(keyBytes, keyLength);
+            }
+            const char* external;
+            memcpy(&external, keyBytes, sizeof(external));
+            return string_view(external, keyLength);
+        }
+};
+
+// Hands out Nodes from slabs of NODES_PER_SLAB and recycles freed ones through a free list.
+// The slabs are released all at once when the pool is destroyed.
+class NodePool {
+    public:
+        NodePool() : freeList(nullptr), used(NODES_PER_SLAB) {}
+
+        Node* allocate();
+        void release(Node* node);
+
+    private:
+        vector<unique_ptr<Node[]>> slabs;
+        Node* freeList;
+        size_t used;
+};
+
+// Bump allocator for key bytes. Nothing is freed individually; space used by deleted keys
+// is given back when the arena is destroyed.
+class StringArena {
+    public:
+        StringArena() : used(0), capacity(0) {}
+
+        const char* store(string_view text);
+
+    private:
+        vector<unique_ptr<char[]>> blocks;
+        size_t used;
+        size_t capacity;
+};
+
+// default bound on keys per bucket before the table doubles; 0 keeps the table at its initial size
+const double DEFAULT_MAX_LOAD_FACTOR = 1.0;
 
-        Node(const string& key, int value = 1, Node* next = nullptr)
-            : key(key), value(value), next(next) {}
+// which kernel a HashTable hashes its keys with
+enum HashKind { RANDOM_HASH, MURMUR_HASH, XX_HASH };
+
+// Point in time summary of a HashTable's chains, over every bucket a lookup could land in
+class ChainStats {
+    public:
+        int keys;
+        int buckets;
+        double loadFactor;
+        double variance;
+        int longestChain;
+        // lengthCounts[l] is the number of buckets whose chain has length l
+        vector<int> lengthCounts;
 };
 
 class HashTable {
     public:
-        HashTable(int size);
-        ~HashTable();
+        HashTable(int size, double maxLoadFactor = DEFAULT_MAX_LOAD_FACTOR, HashKind hashKind = RANDOM_HASH);
 
-        void insert(const string& key, int value);
-        bool deleteKey(const string& key);
-        bool increase(const string& key, int value);
-        int find(const string& key) const;
+        void insert(string_view key, int value);
+        int& upsert(string_view key);
+        bool deleteKey(string_view key);
+        bool increase(string_view key, int value);
+        int find(string_view key) const;
         void listAllKeys() const;
+        template <typename Visitor> void forEach(Visitor visit) const;
         vector<int> calculateCollisionLengths();
         void printCollisionsHistogram();
         double calculateVariance();
         void printLongestLists();
+        double loadFactor() const;
+        ChainStats stats() const;
+        vector<int> longestChains(int k) const;
+        uint32_t hashFunction(string_view key) const;
     
     private:
-        int hashFunction(const string& key) const;
-        int randomHash(const string& key) const;
-        int murmurHash(const string& key) const;
+        uint32_t randomHash(string_view key) const;
+        uint32_t murmurHash(string_view key) const;
+        uint32_t xxHash(string_view key) const;
+        Node*& bucketFor(uint32_t hash);
+        Node* bucketFor(uint32_t hash) const;
+        int& chainLengthFor(uint32_t hash);
+        void changeChainLength(int& length, int delta);
+        int liveBuckets() const;
+        void startResize(int newSize);
+        void migrateBuckets();
+        Node* newNode(string_view key, Node* next, uint32_t hash);
+
+        // every node and long key is owned by these, so the table is torn down a slab at a time
+        NodePool nodePool;
+        StringArena keyArena;
+
         vector<Node*> table;
         int size;
+        int count;
+        double maxLoadFactor;
+        HashKind hashKind;
+
+        // After a resize the old buckets are moved into table a few at a time by later
+        // insertions and deletions; buckets below migrateIndex have already been moved.
+        vector<Node*> oldTable;
+        size_t migrateIndex;
+
+        // Chain lengths kept up to date by every insertion, deletion and migration step, so
+        // statistics never walk the chains: a length per bucket in table and oldTable, how many
+        // live buckets have each length, and the running sum of squared lengths (the plain sum
+        // is count).
+        vector<int> chainLengths;
+        vector<int> oldChainLengths;
+        vector<int> lengthCounts;
+        long long lengthSquares;
 
-        int a;
-        int b;
+        uint64_t a;
+        uint64_t b;
 
         uint32_t seed;
 };
 
-// prime number to be used for randomization and hashing
-const int PRIME = 10000019;
+class Slot {
+    public:
+        string key;
+        int value;
+        uint32_t hash;
 
-HashTable::HashTable(int size) : size(size), table(size, nullptr) {
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<> dist(1, PRIME-1);
+        Slot(string key = "", int value = 0, uint32_t hash = 0)
+            : key(move(key)), value(value), hash(hash) {}
+};
 
-    // initialize constants for randomHash
-    a = dist(gen);
-    b = dist(gen);
+// Open addressing with Robin Hood probing. All entries live in one flat slot array, and a
+// parallel array of control bytes records how far each entry sits from its home slot
+// (0 = empty), so probing mostly touches contiguous bytes instead of chasing pointers.
+class FlatHashTable {
+    public:
+        FlatHashTable(int size);
 
-    // initialize seed for murmurHash
-    seed = static_cast<uint32_t>(dist(gen));
-}
+        void insert(string_view key, int value);
+        int& upsert(string_view key);
+        bool deleteKey(string_view key);
+        bool increase(string_view key, int value);
+        int find(string_view key) const;
+        void listAllKeys() const;
+        template <typename Visitor> void forEach(Visitor visit) const;
+        vector<int> calculateProbeLengths();
+        void printProbeLengthsHistogram();
+        double calculateVariance();
+        size_t capacity() const;
 
-// Clears the entire HashTable from memory
-HashTable::~HashTable() {
-    for (int i = 0; i < size; ++i) {
-        Node* current = table[i];
-        while (current != nullptr) {
-            Node* toDelete = current;
-            current = current->next;
-            delete toDelete;
-        }
-    }
-}
+    private:
+        bool probe(string_view key, uint32_t hash, size_t& index, uint8_t& distance) const;
+        size_t findSlot(string_view key, uint32_t hash) const;
+        size_t placeFrom(Slot entry, size_t index, uint8_t distance);
+        void insertNew(Slot entry);
+        void grow();
+
+        friend bool testLongProbeRun();
+
+        vector<uint8_t> control;
+        vector<Slot> slots;
+        size_t mask;
+        int count;
+
+        uint32_t seed;
+};
+
+class ConcurrentNode {
+    public:
+        const string key;
+        atomic<int> value;
+        atomic<ConcurrentNode*> next;
+        const uint32_t hash;
+
+        ConcurrentNode(string_view key, int value, ConcurrentNode* next, uint32_t hash)
+            : key(key), value(value), next(next), hash(hash) {}
+};
+
+// Epoch based reclamation shared by every ConcurrentHashTable. A thread announces the global
+// epoch in its reader slot while it may hold node pointers, and a node unlinked in epoch e is
+// only freed once the global epoch has reached e + 2, when no reader can still see it.
+class EpochGuard {
+    public:
+        EpochGuard();
+        ~EpochGuard();
+        EpochGuard(const EpochGuard&) = delete;
+        EpochGuard& operator=(const EpochGuard&) = delete;
+
+        static uint64_t currentEpoch();
+        static bool tryAdvance();
+};
+
+// A chained table shared between threads. find never blocks or retries: it walks atomic
+// links under an EpochGuard. Writers take one of LOCK_STRIPES bucket locks, and deleted
+// nodes are retired instead of freed. The bucket count is fixed at construction.
+class ConcurrentHashTable {
+    public:
+        ConcurrentHashTable(int size);
+        ~ConcurrentHashTable();
+        ConcurrentHashTable(const ConcurrentHashTable&) = delete;
+        ConcurrentHashTable& operator=(const ConcurrentHashTable&) = delete;
+
+        void insert(string_view key, int value);
+        atomic<int>& upsert(string_view key);
+        bool deleteKey(string_view key);
+        bool increase(string_view key, int value);
+        int find(string_view key) const;
+
+    private:
+        ConcurrentNode* lookup(string_view key, uint32_t hash) const;
+        ConcurrentNode* findOrAdd(string_view key, uint32_t hash);
+        void retire(ConcurrentNode* node);
+        void reclaim();
+
+        unique_ptr<atomic<ConcurrentNode*>[]> table;
+        int size;
+        unique_ptr<mutex[]> locks;
 
-int HashTable::hashFunction(const string& key) const {
-    return randomHash(key);
+        mutex retireLock;
+        vector<pair<ConcurrentNode*, uint64_t>> retired;
+
+        uint32_t seed;
+};
+
+// control byte of an empty slot, and the first probe distance a control byte may not hold:
+// the table grows before any entry would be stored that far from home
+const uint8_t EMPTY = 0;
+const uint8_t MAX_DISTANCE = 255;
+const size_t NO_SLOT = SIZE_MAX;
+
+// number of old buckets moved into the new table by each insertion or deletion during a resize
+const int MIGRATE_BUCKETS = 4;
+
+// writer locks per ConcurrentHashTable (a power of two), reader slots for the whole process,
+// and how many retired nodes a table collects before it tries to free some. Each thread that
+// reads a ConcurrentHashTable holds a reader slot until it exits, so at most MAX_READERS such
+// threads may be alive at once; the next one aborts with an error.
+const int LOCK_STRIPES = 64;
+const int MAX_READERS = 256;
+const size_t RECLAIM_BATCH = 64;
+
+// Maps a 32 bit hash onto [0, range) with a multiply and shift instead of a modulo
+inline size_t fastRange(uint32_t hash, size_t range) {
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * range) >> 32);
 }
 
-int HashTable::randomHash(const string& key) const {
-    unsigned long hashValue = 0;
-    
-    // Position sensitive hashing ("abc" and "cba" produce different values)
-    for (char c : key) {
-        hashValue = (hashValue * 31 + c) % PRIME;
-    }
+inline uint32_t rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
 
-    // use randomized values to modify value
-    hashValue = (a * hashValue + b) % PRIME;
+inline uint32_t load32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
 
-    // produce a final value within our size
-    return hashValue % size;
+inline uint64_t load64(const char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
 }
 
-int HashTable::murmurHash(const string& key) const {    
+// MurmurHash3 (x86, 32 bit), consuming the key in 4 byte blocks
+uint32_t murmurHash3(string_view key, uint32_t seed) {
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+    const char* data = key.data();
+    size_t blocks = key.size() / 4;
     uint32_t hash = seed;
 
-    for (char c : key) {
-        uint32_t k = static_cast<uint32_t>(c);
+    for (size_t i = 0; i < blocks; ++i) {
+        uint32_t k = load32(data + i * 4);
 
-        k *= 0xcc9e2d51;
-        k = (k << 15) | (k >> 17);
-        k *= 0x1b873593;
+        k *= c1;
+        k = rotl32(k, 15);
+        k *= c2;
 
         hash ^= k;
-        hash = (hash << 13) | (hash >> 19);
+        hash = rotl32(hash, 13);
         hash = hash * 5 + 0xe6546b64;
     }
 
-    hash ^= key.length();
+    // the last 1-3 bytes are mixed in without the block rotation of hash
+    const uint8_t* tail = reinterpret_cast<const uint8_t*>(data + blocks * 4);
+    uint32_t k = 0;
+    switch (key.size() & 3) {
+        case 3: k ^= tail[2] << 16; [[fallthrough]];
+        case 2: k ^= tail[1] << 8; [[fallthrough]];
+        case 1: k ^= tail[0];
+            k *= c1;
+            k = rotl32(k, 15);
+            k *= c2;
+            hash ^= k;
+    }
+
+    hash ^= static_cast<uint32_t>(key.size());
     hash ^= (hash >> 16);
     hash *= 0x85ebca6b;
     hash ^= (hash >> 13);
     hash *= 0xc2b2ae35;
     hash ^= (hash >> 16);
 
-    return hash % size;
-}
-
-void HashTable::insert(const string& key, int value) {
-    if (find(key) != -1) {
-        increase(key, value);
-    } else {
-        int index = hashFunction(key);
-
-        // add new node at the beginning of the corresponding linked list
-        Node* newNode = new Node(key, value, table[index]);
-        table[index] = newNode;
-    }
+    return hash;
 }
 
-bool HashTable::deleteKey(const string& key) {
-    int index = hashFunction(key);
-    Node* current = table[index];
-    Node* previous = nullptr;
+const uint32_t XX_PRIME1 = 0x9E3779B1;
+const uint32_t XX_PRIME2 = 0x85EBCA77;
+const uint32_t XX_PRIME3 = 0xC2B2AE3D;
+const uint32_t XX_PRIME4 = 0x27D4EB2F;
+const uint32_t XX_PRIME5 = 0x165667B1;
 
-    while (current != nullptr) {
-        if (current->key == key) {
-            if (previous == nullptr) {
-                table[index] = current->next;
-            }
-            else {
-                previous->next = current->next;
-            }
-            delete current;
-            return true;
+// Runs the four xxHash32 lanes over count 16 byte stripes
+void xxStripesScalar(const char* p, size_t count, uint32_t acc[4]) {
+    for (size_t i = 0; i < count; ++i, p += 16) {
+        for (int lane = 0; lane < 4; ++lane) {
+            acc[lane] = rotl32(acc[lane] + load32(p + lane * 4) * XX_PRIME2, 13) * XX_PRIME1;
         }
-        previous = current;
-        current = current->next;
     }
-
-    // key not found, did not delete anything
-    return false;
 }
 
-bool HashTable::increase(const string& key, int value) {
-    int index = hashFunction(key);
-    Node* current = table[index];
+#ifdef HASH_TABLE_X86
+// The same four lanes held in one SSE register, one stripe per iteration
+__attribute__((target("sse4.1")))
+void xxStripesSse41(const char* p, size_t count, uint32_t acc[4]) {
+    const __m128i prime1 = _mm_set1_epi32(static_cast<int>(XX_PRIME1));
+    const __m128i prime2 = _mm_set1_epi32(static_cast<int>(XX_PRIME2));
+    __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc));
 
-    while (current != nullptr) {
-        if (current->key == key) {
-            current->value += value;
-            return true;
-        }
-        current = current->next;
+    for (size_t i = 0; i < count; ++i, p += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        lanes = _mm_add_epi32(lanes, _mm_mullo_epi32(input, prime2));
+        lanes = _mm_or_si128(_mm_slli_epi32(lanes, 13), _mm_srli_epi32(lanes, 19));
+        lanes = _mm_mullo_epi32(lanes, prime1);
     }
 
-    // key not found, didn't increase
-    return false;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), lanes);
 }
+#endif
 
-int HashTable::find(const string& key) const {
-    int index = hashFunction(key);
-    Node* current = table[index];
+typedef void (*StripeKernel)(const char*, size_t, uint32_t*);
 
-    while (current != nullptr) {
-        if (current->key == key) {
-            return current->value;
-        }
-        current = current->next;
+StripeKernel selectStripeKernel() {
+#ifdef HASH_TABLE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) {
+        return xxStripesSse41;
     }
-
-    return -1;
+#endif
+    return xxStripesScalar;
 }
 
-void HashTable::listAllKeys() const {
-    for (Node* head : table) {
-        Node* current = head;
-
-        while (current != nullptr) {
-            cout << "Key: " << current->key << ", Value: " << current->value << endl;
-            current = current->next;
-        }
-    }
-}
+// picked once at startup from what the CPU supports
+const StripeKernel xxStripes = selectStripeKernel();
 
-vector<int> HashTable::calculateCollisionLengths() {
-    vector<int> lengths;
+// xxHash32; keys of 16 bytes or more run their stripes through the vectorized kernel
+uint32_t xxHash32(string_view key, uint32_t seed) {
+    const char* p = key.data();
+    const char* end = p + key.size();
+    uint32_t hash;
 
-    for (Node* head : table) {
-        int length = 0;
-        Node* current = head;
+    if (key.size() >= 16) {
+        uint32_t acc[4] = {seed + XX_PRIME1 + XX_PRIME2, seed + XX_PRIME2, seed, seed - XX_PRIME1};
+        size_t stripes = key.size() / 16;
+        xxStripes(p, stripes, acc);
+        p += stripes * 16;
+        hash = rotl32(acc[0], 1) + rotl32(acc[1], 7) + rotl32(acc[2], 12) + rotl32(acc[3], 18);
+    } else {
+        hash = seed + XX_PRIME5;
+    }
 
-        while (current != nullptr) {
-            ++length;
-            current = current->next;
-        }
+    hash += static_cast<uint32_t>(key.size());
 
-        lengths.push_back(length);
+    for (; p + 4 <= end; p += 4) {
+        hash = rotl32(hash + load32(p) * XX_PRIME3, 17) * XX_PRIME4;
+    }
+    for (; p < end; ++p) {
+        hash = rotl32(hash + static_cast<uint8_t>(*p) * XX_PRIME5, 11) * XX_PRIME1;
     }
 
-    return lengths;
-}
+    hash ^= hash >> 15;
+    hash *= XX_PRIME2;
+    hash ^= hash >> 13;
+    hash *= XX_PRIME3;
+    hash ^= hash >> 16;
 
-void HashTable::printCollisionsHistogram() {
-    vector<int> lengths = calculateCollisionLengths();
+    return hash;
+}
 
-    int min = INT_MAX;
-    int max = INT_MIN;
-    for (int length : lengths) {
-        if (length < min) {
-            min = length;
-        }
-        if (length > max) {
-            max = length;
-        }
+// Prints one row per length between the shortest and longest length, where buckets[l] is the
+// number of lists of length l
+void printHistogram(const vector<int>& buckets) {
+    int max = static_cast<int>(buckets.size()) - 1;
+    while (max >= 0 && buckets[max] == 0) {
+        --max;
     }
-
-    vector<int> buckets(max + 1, 0);
-
-    for (int length : lengths) {
-        ++buckets[length];
+    if (max < 0) {
+        return;
     }
 
     int i = 0;
@@ -250,8 +463,26 @@ void HashTable::printCollisionsHistogram() {
     }
 }
 
-double HashTable::calculateVariance() {
-    vector<int> lengths = calculateCollisionLengths();
+void printLengthsHistogram(const vector<int>& lengths) {
+    if (lengths.empty()) {
+        return;
+    }
+
+    int max = *max_element(lengths.begin(), lengths.end());
+    vector<int> buckets(max + 1, 0);
+
+    for (int length : lengths) {
+        ++buckets[length];
+    }
+
+    printHistogram(buckets);
+}
+
+// Population variance of a list of lengths
+double lengthsVariance(const vector<int>& lengths) {
+    if (lengths.empty()) {
+        return 0;
+    }
 
     double mean = accumulate(lengths.begin(), lengths.end(), 0.0) / lengths.size();
     double variance = 0;
@@ -262,50 +493,1280 @@ double HashTable::calculateVariance() {
     return variance / lengths.size();
 }
 
-void HashTable::printLongestLists() {
-    vector<int> lengths = calculateCollisionLengths();
+HashTable::HashTable(int size, double maxLoadFactor, HashKind hashKind)
+    : table(size, nullptr), size(size), count(0), maxLoadFactor(maxLoadFactor), hashKind(hashKind), migrateIndex(0),
+      chainLengths(size, 0), lengthCounts(1, size), lengthSquares(0) {
+    random_device rd;
+    mt19937_64 gen((static_cast<uint64_t>(rd()) << 32) | rd());
 
-    sort(lengths.begin(), lengths.end(), greater<int>());
-    cout << "Lengths of the 10% longest lists are: ";
-    for (int i = 0; i < lengths.size() / 10; ++i) {
-        cout << lengths[i] << " ";
+    // initialize constants for randomHash (the multiplier must be odd)
+    a = gen() | 1;
+    b = gen();
+
+    // initialize seed for murmurHash and xxHash
+    seed = static_cast<uint32_t>(gen());
+}
+
+Node* NodePool::allocate() {
+    if (freeList) {
+        Node* node = freeList;
+        freeList = node->next;
+        return node;
     }
-    cout << endl;
+
+    if (used == NODES_PER_SLAB) {
+        slabs.emplace_back(new Node[NODES_PER_SLAB]);
+        used = 0;
+    }
+    return &slabs.back()[used++];
 }
 
-void loadFileIntoHashTable(const string& filename, HashTable& hashTable) {
-    ifstream file(filename);
-    string line;
-    string word;
+void NodePool::release(Node* node) {
+    node->next = freeList;
+    freeList = node;
+}
 
-    while (getline(file,line)) {
-        istringstream iss(line);
-        while (iss >> word) {
-            // Normalize the word (convert to lowercase and remove punctuation)
-            word.erase(remove_if(word.begin(), word.end(), ::ispunct), word.end());
-            transform(word.begin(), word.end(), word.begin(), ::tolower);
-            
-            // Insert the word into the hash table
-            hashTable.insert(word, 1);
+const char* StringArena::store(string_view text) {
+    if (capacity - used < text.size()) {
+        capacity = max(ARENA_BLOCK_SIZE, text.size());
+        blocks.emplace_back(new char[capacity]);
+        used = 0;
+    }
+
+    char* stored = blocks.back().get() + used;
+    memcpy(stored, text.data(), text.size());
+    used += text.size();
+    return stored;
+}
+
+// Takes a node from the pool and fills it in with a value of 0, copying the key inline if it fits
+Node* HashTable::newNode(string_view key, Node* next, uint32_t hash) {
+    Node* node = nodePool.allocate();
+    node->next = next;
+    node->hash = hash;
+    node->value = 0;
+    node->keyLength = static_cast<uint32_t>(key.size());
+
+    if (key.size() <= INLINE_KEY_LENGTH) {
+        memcpy(node->keyBytes, key.data(), key.size());
+    } else {
+        const char* external = keyArena.store(key);
+        memcpy(node->keyBytes, &external, sizeof(external));
+    }
+
+    return node;
+}
+
+uint32_t HashTable::hashFunction(string_view key) const {
+    switch (hashKind) {
+        case MURMUR_HASH: return murmurHash(key);
+        case XX_HASH: return xxHash(key);
+        default: return randomHash(key);
+    }
+}
+
+// Head of the chain that holds (or would hold) a key with this hash
+Node*& HashTable::bucketFor(uint32_t hash) {
+    if (!oldTable.empty()) {
+        size_t oldIndex = fastRange(hash, oldTable.size());
+        if (oldIndex >= migrateIndex) {
+            return oldTable[oldIndex];
         }
     }
+    return table[fastRange(hash, size)];
 }
 
-int main() {
-    int m;
-    cout << "Enter the size of the Hash table: ";
-    cin >> m;
+Node* HashTable::bucketFor(uint32_t hash) const {
+    return const_cast<HashTable*>(this)->bucketFor(hash);
+}
 
-    HashTable hashTable = HashTable(m);
+double HashTable::loadFactor() const {
+    return static_cast<double>(count) / size;
+}
 
-    loadFileIntoHashTable("alice_in_wonderland.txt", hashTable);
+int& HashTable::chainLengthFor(uint32_t hash) {
+    if (!oldTable.empty()) {
+        size_t oldIndex = fastRange(hash, oldTable.size());
+        if (oldIndex >= migrateIndex) {
+            return oldChainLengths[oldIndex];
+        }
+    }
+    return chainLengths[fastRange(hash, size)];
+}
 
-    cout << "\nReading Alice in Wonderland..." << endl;
+// Moves one bucket's chain length by delta and updates the running totals with it
+void HashTable::changeChainLength(int& length, int delta) {
+    --lengthCounts[length];
+    lengthSquares -= static_cast<long long>(length) * length;
 
-    cout << "\nHistogram of Collision Lists' Lengths:" << endl;
-    hashTable.printCollisionsHistogram();
+    length += delta;
 
-    cout << "\nVariance of collision list lengths: " << hashTable.calculateVariance() << "\n" << endl;
+    if (length >= static_cast<int>(lengthCounts.size())) {
+        lengthCounts.resize(length + 1, 0);
+    }
+    ++lengthCounts[length];
+    lengthSquares += static_cast<long long>(length) * length;
 
-    hashTable.printLongestLists();
+    while (lengthCounts.size() > 1 && lengthCounts.back() == 0) {
+        lengthCounts.pop_back();
+    }
+}
+
+// Buckets a key could currently hash to: all of table plus the old buckets not yet migrated
+int HashTable::liveBuckets() const {
+    return size + static_cast<int>(oldTable.size() - migrateIndex);
+}
+
+// O(longest chain); nothing here walks a chain or scans the buckets
+ChainStats HashTable::stats() const {
+    ChainStats snapshot;
+    snapshot.keys = count;
+    snapshot.buckets = liveBuckets();
+    snapshot.loadFactor = static_cast<double>(count) / snapshot.buckets;
+
+    double mean = snapshot.loadFactor;
+    snapshot.variance = static_cast<double>(lengthSquares) / snapshot.buckets - mean * mean;
+    snapshot.longestChain = static_cast<int>(lengthCounts.size()) - 1;
+    snapshot.lengthCounts = lengthCounts;
+
+    return snapshot;
+}
+
+// Lengths of the k longest chains, longest first, read off the length counts from the top
+vector<int> HashTable::longestChains(int k) const {
+    vector<int> lengths;
+
+    for (int length = static_cast<int>(lengthCounts.size()) - 1; length >= 0 && static_cast<int>(lengths.size()) < k; --length) {
+        int take = min(lengthCounts[length], k - static_cast<int>(lengths.size()));
+        lengths.insert(lengths.end(), take, length);
+    }
+
+    return lengths;
+}
+
+void HashTable::startResize(int newSize) {
+    // a resize that is still running is finished first, which only happens if the table
+    // is filled faster than MIGRATE_BUCKETS per operation can drain the previous one
+    while (!oldTable.empty()) {
+        migrateBuckets();
+    }
+
+    oldTable.swap(table);
+    table.assign(newSize, nullptr);
+    oldChainLengths.swap(chainLengths);
+    chainLengths.assign(newSize, 0);
+    lengthCounts[0] += newSize;
+    size = newSize;
+    migrateIndex = 0;
+}
+
+void HashTable::migrateBuckets() {
+    if (oldTable.empty()) {
+        return;
+    }
+
+    for (int moved = 0; moved < MIGRATE_BUCKETS && migrateIndex < oldTable.size(); ++moved) {
+        // the emptied old bucket stops counting as a live bucket
+        changeChainLength(oldChainLengths[migrateIndex], -oldChainLengths[migrateIndex]);
+        --lengthCounts[0];
+
+        Node* current = oldTable[migrateIndex];
+        while (current != nullptr) {
+            Node* next = current->next;
+            size_t index = fastRange(current->hash, size);
+            current->next = table[index];
+            table[index] = current;
+            changeChainLength(chainLengths[index], 1);
+            current = next;
+        }
+        oldTable[migrateIndex] = nullptr;
+        ++migrateIndex;
+    }
+
+    if (migrateIndex == oldTable.size()) {
+        vector<Node*>().swap(oldTable);
+        vector<int>().swap(oldChainLengths);
+        migrateIndex = 0;
+    }
+}
+
+uint32_t HashTable::randomHash(string_view key) const {
+    const char* p = key.data();
+    size_t length = key.size();
+    uint64_t hashValue = length;
+
+    // Position sensitive hashing ("abc" and "cba" produce different values), eight bytes at a
+    // time with arithmetic modulo 2^64 so no division is needed per step. Multiplying only moves
+    // bits upwards, so each step folds the high half back down; without it, keys that differ
+    // only in the top bit of their 8 byte blocks all land in two buckets.
+    for (; length >= 8; p += 8, length -= 8) {
+        hashValue = (hashValue + load64(p)) * a;
+        hashValue ^= hashValue >> 32;
+    }
+    if (length > 0) {
+        uint64_t last = 0;
+        memcpy(&last, p, length);
+        hashValue = (hashValue + last) * a;
+        hashValue ^= hashValue >> 32;
+    }
+
+    // use randomized values to modify value, keeping the well mixed high half (multiply-shift)
+    return static_cast<uint32_t>((a * hashValue + b) >> 32);
+}
+
+uint32_t HashTable::murmurHash(string_view key) const {
+    return murmurHash3(key, seed);
+}
+
+uint32_t HashTable::xxHash(string_view key) const {
+    return xxHash32(key, seed);
+}
+
+void HashTable::insert(string_view key, int value) {
+    upsert(key) += value;
+}
+
+// Returns the counter for key, adding it with a value of 0 if it is new. The key is hashed
+// once and its chain walked once. Its bytes are only copied when it is new, inline into the
+// node if it is short and into the StringArena otherwise. Nodes never move, so the reference
+// stays valid until the key is deleted.
+int& HashTable::upsert(string_view key) {
+    migrateBuckets();
+
+    uint32_t hash = hashFunction(key);
+    Node*& head = bucketFor(hash);
+
+    for (Node* current = head; current != nullptr; current = current->next) {
+        if (current->hash == hash && current->key() == key) {
+            return current->value;
+        }
+    }
+
+    // add new node at the beginning of the corresponding linked list
+    Node* added = newNode(key, head, hash);
+    head = added;
+    ++count;
+    changeChainLength(chainLengthFor(hash), 1);
+
+    if (maxLoadFactor > 0 && count > maxLoadFactor * size) {
+        startResize(size * 2);
+    }
+
+    return added->value;
+}
+
+bool HashTable::deleteKey(string_view key) {
+    migrateBuckets();
+
+    uint32_t hash = hashFunction(key);
+    Node*& head = bucketFor(hash);
+    Node* current = head;
+    Node* previous = nullptr;
+
+    while (current != nullptr) {
+        if (current->hash == hash && current->key() == key) {
+            if (previous == nullptr) {
+                head = current->next;
+            }
+            else {
+                previous->next = current->next;
+            }
+            nodePool.release(current);
+            --count;
+            changeChainLength(chainLengthFor(hash), -1);
+            return true;
+        }
+        previous = current;
+        current = current->next;
+    }
+
+    // key not found, did not delete anything
+    return false;
+}
+
+bool HashTable::increase(string_view key, int value) {
+    uint32_t hash = hashFunction(key);
+    Node* current = bucketFor(hash);
+
+    while (current != nullptr) {
+        if (current->hash == hash && current->key() == key) {
+            current->value += value;
+            return true;
+        }
+        current = current->next;
+    }
+
+    // key not found, didn't increase
+    return false;
+}
+
+int HashTable::find(string_view key) const {
+    uint32_t hash = hashFunction(key);
+    Node* current = bucketFor(hash);
+
+    while (current != nullptr) {
+        if (current->hash == hash && current->key() == key) {
+            return current->value;
+        }
+        current = current->next;
+    }
+
+    return -1;
+}
+
+void HashTable::listAllKeys() const {
+    for (const vector<Node*>* buckets : {&oldTable, &table}) {
+        for (Node* head : *buckets) {
+            Node* current = head;
+
+            while (current != nullptr) {
+                cout << "Key: " << current->key() << ", Value: " << current->value << endl;
+                current = current->next;
+            }
+        }
+    }
+}
+
+// Calls visit(key, value) for every key in the table
+template <typename Visitor>
+void HashTable::forEach(Visitor visit) const {
+    for (const vector<Node*>* buckets : {&oldTable, &table}) {
+        for (Node* head : *buckets) {
+            for (Node* current = head; current != nullptr; current = current->next) {
+                visit(current->key(), current->value);
+            }
+        }
+    }
+}
+
+// Lengths of every live chain, including old buckets that have not been migrated yet
+vector<int> HashTable::calculateCollisionLengths() {
+    vector<int> lengths(oldChainLengths.begin() + min(migrateIndex, oldChainLengths.size()), oldChainLengths.end());
+    lengths.insert(lengths.end(), chainLengths.begin(), chainLengths.end());
+    return lengths;
+}
+
+void HashTable::printCollisionsHistogram() {
+    printHistogram(lengthCounts);
+}
+
+double HashTable::calculateVariance() {
+    return stats().variance;
+}
+
+void HashTable::printLongestLists() {
+    cout << "Lengths of the 10% longest lists are: ";
+    for (int length : longestChains(liveBuckets() / 10)) {
+        cout << length << " ";
+    }
+    cout << endl;
+}
+
+FlatHashTable::FlatHashTable(int size) : mask(0), count(0) {
+    // round the requested size up to a power of two so the home slot is a mask, not a modulo
+    size_t capacity = 8;
+    while (capacity < static_cast<size_t>(size)) {
+        capacity <<= 1;
+    }
+    control.assign(capacity, EMPTY);
+    slots.resize(capacity);
+    mask = capacity - 1;
+
+    random_device rd;
+    seed = rd();
+}
+
+// Walks the probe sequence of key once. Returns true with the key's slot if it is present,
+// otherwise false with the slot and distance at which it would be placed.
+bool FlatHashTable::probe(string_view key, uint32_t hash, size_t& index, uint8_t& distance) const {
+    index = hash & mask;
+    distance = 1;
+
+    // Robin Hood invariant: once a slot is closer to its home than we are to ours, the key is
+    // absent. No entry is stored MAX_DISTANCE or further from home, so the probe stops there.
+    while (distance < MAX_DISTANCE && control[index] >= distance) {
+        if (control[index] == distance && slots[index].hash == hash && slots[index].key == key) {
+            return true;
+        }
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    return false;
+}
+
+size_t FlatHashTable::findSlot(string_view key, uint32_t hash) const {
+    size_t index;
+    uint8_t distance;
+    return probe(key, hash, index, distance) ? index : NO_SLOT;
+}
+
+// Places entry starting at index, which is distance - 1 slots past its home. Returns the slot
+// entry ended up in, or NO_SLOT if the table had to grow on the way and every slot moved.
+size_t FlatHashTable::placeFrom(Slot entry, size_t index, uint8_t distance) {
+    size_t placed = NO_SLOT;
+
+    while (true) {
+        if (distance == MAX_DISTANCE) {
+            // the probe sequence no longer fits in a control byte, so spread the table out
+            grow();
+            insertNew(move(entry));
+            return NO_SLOT;
+        }
+        if (control[index] == EMPTY) break;
+
+        // take the slot from any entry that is closer to home than we are, and carry it onwards
+        if (control[index] < distance) {
+            swap(control[index], distance);
+            swap(slots[index], entry);
+            if (placed == NO_SLOT) {
+                placed = index;
+            }
+        }
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    control[index] = distance;
+    slots[index] = move(entry);
+    ++count;
+    return (placed == NO_SLOT) ? index : placed;
+}
+
+void FlatHashTable::insertNew(Slot entry) {
+    // keep the load factor at or below 7/8
+    if ((count + 1) * 8 > static_cast<long>(slots.size()) * 7) {
+        grow();
+    }
+
+    size_t home = entry.hash & mask;
+    placeFrom(move(entry), home, 1);
+}
+
+void FlatHashTable::grow() {
+    vector<uint8_t> oldControl(slots.size() * 2, EMPTY);
+    vector<Slot> oldSlots(slots.size() * 2);
+    control.swap(oldControl);
+    slots.swap(oldSlots);
+    mask = slots.size() - 1;
+    count = 0;
+
+    for (size_t i = 0; i < oldSlots.size(); ++i) {
+        if (oldControl[i] != EMPTY) {
+            insertNew(move(oldSlots[i]));
+        }
+    }
+}
+
+void FlatHashTable::insert(string_view key, int value) {
+    upsert(key) += value;
+}
+
+// Returns the counter for key, adding it with a value of 0 if it is new. The key is hashed
+// once and its probe sequence walked once. The reference is only valid until the next insertion
+// or deletion, since either can move entries between slots.
+int& FlatHashTable::upsert(string_view key) {
+    // make room up front so the slot found by the probe is still where the key belongs
+    if ((count + 1) * 8 > static_cast<long>(slots.size()) * 7) {
+        grow();
+    }
+
+    uint32_t hash = murmurHash3(key, seed);
+    size_t index;
+    uint8_t distance;
+    if (probe(key, hash, index, distance)) {
+        return slots[index].value;
+    }
+
+    size_t placed = placeFrom(Slot(string(key), 0, hash), index, distance);
+    if (placed == NO_SLOT) {
+        placed = findSlot(key, hash);
+    }
+    return slots[placed].value;
+}
+
+bool FlatHashTable::deleteKey(string_view key) {
+    size_t index = findSlot(key, murmurHash3(key, seed));
+    if (index == NO_SLOT) {
+        // key not found, did not delete anything
+        return false;
+    }
+
+    // backward shift: pull the following displaced entries one slot closer to home
+    size_t next = (index + 1) & mask;
+    while (control[next] > 1) {
+        control[index] = control[next] - 1;
+        slots[index] = move(slots[next]);
+        index = next;
+        next = (next + 1) & mask;
+    }
+
+    control[index] = EMPTY;
+    slots[index] = Slot();
+    --count;
+    return true;
+}
+
+bool FlatHashTable::increase(string_view key, int value) {
+    size_t index = findSlot(key, murmurHash3(key, seed));
+    if (index == NO_SLOT) {
+        // key not found, didn't increase
+        return false;
+    }
+
+    slots[index].value += value;
+    return true;
+}
+
+int FlatHashTable::find(string_view key) const {
+    size_t index = findSlot(key, murmurHash3(key, seed));
+    return (index == NO_SLOT) ? -1 : slots[index].value;
+}
+
+void FlatHashTable::listAllKeys() const {
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (control[i] != EMPTY) {
+            cout << "Key: " << slots[i].key << ", Value: " << slots[i].value << endl;
+        }
+    }
+}
+
+// Calls visit(key, value) for every key in the table
+template <typename Visitor>
+void FlatHashTable::forEach(Visitor visit) const {
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (control[i] != EMPTY) {
+            visit(slots[i].key, slots[i].value);
+        }
+    }
+}
+
+// Number of extra slots each key is away from its home slot
+vector<int> FlatHashTable::calculateProbeLengths() {
+    vector<int> lengths;
+
+    for (uint8_t distance : control) {
+        if (distance != EMPTY) {
+            lengths.push_back(distance - 1);
+        }
+    }
+
+    return lengths;
+}
+
+void FlatHashTable::printProbeLengthsHistogram() {
+    printLengthsHistogram(calculateProbeLengths());
+}
+
+double FlatHashTable::calculateVariance() {
+    return lengthsVariance(calculateProbeLengths());
+}
+
+size_t FlatHashTable::capacity() const {
+    return slots.size();
+}
+
+// epoch 0 marks a reader slot that is not inside a guard
+atomic<uint64_t> globalEpoch(1);
+
+struct alignas(64) ReaderSlot {
+    atomic<uint64_t> epoch;
+    atomic<bool> claimed;
+};
+
+ReaderSlot readerSlots[MAX_READERS];
+
+// Claims a reader slot the first time a thread takes a guard and frees it when the thread exits
+class ReaderSlotOwner {
+    public:
+        ReaderSlot* slot;
+        int depth;
+
+        ReaderSlotOwner() : slot(nullptr), depth(0) {
+            for (ReaderSlot& candidate : readerSlots) {
+                bool expected = false;
+                if (candidate.claimed.compare_exchange_strong(expected, true)) {
+                    slot = &candidate;
+                    return;
+                }
+            }
+            // a free slot only appears when some reader thread exits, which may never happen
+            cerr << "ConcurrentHashTable: more than " << MAX_READERS << " reader threads alive at once" << endl;
+            abort();
+        }
+
+        ~ReaderSlotOwner() {
+            slot->claimed.store(false);
+        }
+};
+
+thread_local ReaderSlotOwner readerSlotOwner;
+
+EpochGuard::EpochGuard() {
+    // guards may nest; only the outermost one publishes an epoch
+    if (readerSlotOwner.depth++ == 0) {
+        readerSlotOwner.slot->epoch.store(globalEpoch.load());
+    }
+}
+
+EpochGuard::~EpochGuard() {
+    if (--readerSlotOwner.depth == 0) {
+        readerSlotOwner.slot->epoch.store(0);
+    }
+}
+
+uint64_t EpochGuard::currentEpoch() {
+    return globalEpoch.load();
+}
+
+// Moves the global epoch forward if every active reader has already seen the current one
+bool EpochGuard::tryAdvance() {
+    uint64_t epoch = globalEpoch.load();
+    for (ReaderSlot& slot : readerSlots) {
+        uint64_t seen = slot.epoch.load();
+        if (seen != 0 && seen != epoch) {
+            return false;
+        }
+    }
+    return globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+}
+
+ConcurrentHashTable::ConcurrentHashTable(int size)
+    : table(new atomic<ConcurrentNode*>[size]), size(size), locks(new mutex[LOCK_STRIPES]) {
+    for (int i = 0; i < size; ++i) {
+        table[i].store(nullptr, memory_order_relaxed);
+    }
+
+    random_device rd;
+    seed = rd();
+}
+
+// Only safe once no other thread is using the table
+ConcurrentHashTable::~ConcurrentHashTable() {
+    for (int i = 0; i < size; ++i) {
+        ConcurrentNode* current = table[i].load(memory_order_relaxed);
+        while (current != nullptr) {
+            ConcurrentNode* toDelete = current;
+            current = current->next.load(memory_order_relaxed);
+            delete toDelete;
+        }
+    }
+
+    for (auto& [node, epoch] : retired) {
+        delete node;
+    }
+}
+
+// Must be called inside an EpochGuard, which keeps the returned node alive
+ConcurrentNode* ConcurrentHashTable::lookup(string_view key, uint32_t hash) const {
+    ConcurrentNode* current = table[fastRange(hash, size)].load(memory_order_acquire);
+
+    while (current != nullptr) {
+        if (current->hash == hash && current->key == key) {
+            return current;
+        }
+        current = current->next.load(memory_order_acquire);
+    }
+
+    return nullptr;
+}
+
+// Returns the node for key, adding it with a value of 0 if it is new. Existing keys are found
+// without locking. Must be called inside an EpochGuard.
+ConcurrentNode* ConcurrentHashTable::findOrAdd(string_view key, uint32_t hash) {
+    ConcurrentNode* node = lookup(key, hash);
+    if (node) {
+        return node;
+    }
+
+    size_t index = fastRange(hash, size);
+    lock_guard<mutex> lock(locks[index & (LOCK_STRIPES - 1)]);
+
+    // another writer may have added the key between the lookup and taking the lock
+    ConcurrentNode* head = table[index].load(memory_order_relaxed);
+    for (ConcurrentNode* current = head; current != nullptr; current = current->next.load(memory_order_relaxed)) {
+        if (current->hash == hash && current->key == key) {
+            return current;
+        }
+    }
+
+    // the release store publishes the fully built node to readers
+    ConcurrentNode* newNode = new ConcurrentNode(key, 0, head, hash);
+    table[index].store(newNode, memory_order_release);
+    return newNode;
+}
+
+void ConcurrentHashTable::insert(string_view key, int value) {
+    EpochGuard guard;
+    findOrAdd(key, xxHash32(key, seed))->value.fetch_add(value);
+}
+
+// Returns the counter for key, adding it with a value of 0 if it is new. The counter outlives
+// the internal guard, so it must not be used once another thread may have deleted the key.
+atomic<int>& ConcurrentHashTable::upsert(string_view key) {
+    EpochGuard guard;
+    return findOrAdd(key, xxHash32(key, seed))->value;
+}
+
+bool ConcurrentHashTable::deleteKey(string_view key) {
+    uint32_t hash = xxHash32(key, seed);
+    size_t index = fastRange(hash, size);
+    ConcurrentNode* removed = nullptr;
+
+    {
+        lock_guard<mutex> lock(locks[index & (LOCK_STRIPES - 1)]);
+        atomic<ConcurrentNode*>* link = &table[index];
+        ConcurrentNode* current = link->load(memory_order_relaxed);
+
+        while (current != nullptr) {
+            if (current->hash == hash && current->key == key) {
+                // readers already on the node keep following its next pointer, which still works
+                link->store(current->next.load(memory_order_relaxed), memory_order_release);
+                removed = current;
+                break;
+            }
+            link = &current->next;
+            current = current->next.load(memory_order_relaxed);
+        }
+    }
+
+    if (!removed) {
+        // key not found, did not delete anything
+        return false;
+    }
+
+    retire(removed);
+    return true;
+}
+
+bool ConcurrentHashTable::increase(string_view key, int value) {
+    EpochGuard guard;
+    ConcurrentNode* node = lookup(key, xxHash32(key, seed));
+    if (!node) {
+        // key not found, didn't increase
+        return false;
+    }
+
+    node->value.fetch_add(value);
+    return true;
+}
+
+int ConcurrentHashTable::find(string_view key) const {
+    EpochGuard guard;
+    ConcurrentNode* node = lookup(key, xxHash32(key, seed));
+    return node ? node->value.load(memory_order_relaxed) : -1;
+}
+
+void ConcurrentHashTable::retire(ConcurrentNode* node) {
+    lock_guard<mutex> lock(retireLock);
+    retired.emplace_back(node, EpochGuard::currentEpoch());
+
+    if (retired.size() >= RECLAIM_BATCH) {
+        reclaim();
+    }
+}
+
+// Frees retired nodes that no reader can reach anymore; called with retireLock held
+void ConcurrentHashTable::reclaim() {
+    EpochGuard::tryAdvance();
+    uint64_t epoch = EpochGuard::currentEpoch();
+
+    auto stillVisible = partition(retired.begin(), retired.end(), [&](const pair<ConcurrentNode*, uint64_t>& entry) {
+        return entry.second + 2 > epoch;
+    });
+    for (auto it = stillVisible; it != retired.end(); ++it) {
+        delete it->first;
+    }
+    retired.erase(stillVisible, retired.end());
+}
+
+// Read-only memory mapping of a whole file. data() is null when the file is missing or empty.
+class MappedFile {
+    public:
+        MappedFile(const string& filename);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return bytes; }
+        size_t size() const { return length; }
+
+    private:
+        const char* bytes;
+        size_t length;
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#endif
+};
+
+#ifdef _WIN32
+MappedFile::MappedFile(const string& filename) : bytes(nullptr), length(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        return;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+        bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        length = bytes ? static_cast<size_t>(fileSize.QuadPart) : 0;
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const string& filename) : bytes(nullptr), length(0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0) {
+        return;
+    }
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            madvise(address, info.st_size, MADV_SEQUENTIAL);
+            bytes = static_cast<const char*>(address);
+            length = info.st_size;
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+}
+#endif
+
+// Counts every whitespace separated word in [begin, end) in a single pass over the bytes.
+// Words are lowercased with punctuation removed. A word that is already in that form is
+// passed to the table as a view of the input; only words that need changes are rebuilt,
+// in a buffer that is reused for the whole range.
+template <typename Table>
+void countWords(const char* begin, const char* end, Table& hashTable) {
+    string buffer;
+    const char* p = begin;
+
+    while (p < end) {
+        while (p < end && isspace(static_cast<unsigned char>(*p))) {
+            ++p;
+        }
+        if (p == end) {
+            break;
+        }
+
+        const char* start = p;
+        bool rewritten = false;
+
+        for (; p < end; ++p) {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (isspace(c)) {
+                break;
+            }
+
+            bool keep = !ispunct(c);
+            char normalized = static_cast<char>(tolower(c));
+            if (!rewritten && (!keep || normalized != *p)) {
+                // first character that changes: switch to building the word in the buffer
+                buffer.assign(start, p);
+                rewritten = true;
+            }
+            if (rewritten && keep) {
+                buffer.push_back(normalized);
+            }
+        }
+
+        ++hashTable.upsert(rewritten ? string_view(buffer) : string_view(start, p - start));
+    }
+}
+
+// Maps the file and counts its words on the calling thread
+template <typename Table>
+void loadFileIntoHashTable(const string& filename, Table& hashTable) {
+    MappedFile file(filename);
+    countWords(file.data(), file.data() + file.size(), hashTable);
+}
+
+// Cuts [data, data + length) into parts chunks, moving each split point forward to the next
+// whitespace so no word is cut in two. Chunk i is [bounds[i], bounds[i + 1]).
+vector<size_t> splitOnWhitespace(const char* data, size_t length, int parts) {
+    vector<size_t> bounds(parts + 1, length);
+    bounds[0] = 0;
+
+    for (int i = 1; i < parts; ++i) {
+        size_t bound = max(length / parts * i, bounds[i - 1]);
+        while (bound < length && !isspace(static_cast<unsigned char>(data[bound]))) {
+            ++bound;
+        }
+        bounds[i] = bound;
+    }
+
+    return bounds;
+}
+
+// Splits the file into one chunk per thread on whitespace boundaries, counts each chunk into a
+// thread-local table, and then merges the local tables into hashTable
+template <typename Table>
+void loadFileIntoHashTableParallel(const string& filename, Table& hashTable, int threadCount) {
+    MappedFile file(filename);
+
+    threadCount = max(threadCount, 1);
+    const char* data = file.data();
+    size_t length = file.size();
+
+    vector<size_t> bounds = splitOnWhitespace(data, length, threadCount);
+
+    vector<FlatHashTable> localTables(threadCount, FlatHashTable(1024));
+    vector<thread> workers;
+    for (int i = 0; i < threadCount; ++i) {
+        workers.emplace_back([&, i]() {
+            countWords(data + bounds[i], data + bounds[i + 1], localTables[i]);
+        });
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    for (const FlatHashTable& localTable : localTables) {
+        localTable.forEach([&](string_view key, int value) {
+            hashTable.upsert(key) += value;
+        });
+    }
+}
+
+// Splits the file into one chunk per thread and has every thread count straight into the shared table
+void loadFileIntoConcurrentHashTable(const string& filename, ConcurrentHashTable& hashTable, int threadCount) {
+    MappedFile file(filename);
+
+    threadCount = max(threadCount, 1);
+    const char* data = file.data();
+    vector<size_t> bounds = splitOnWhitespace(data, file.size(), threadCount);
+
+    vector<thread> workers;
+    for (int i = 0; i < threadCount; ++i) {
+        workers.emplace_back([&, i]() {
+            countWords(data + bounds[i], data + bounds[i + 1], hashTable);
+        });
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+const char* const HASH_NAMES[] = {"random", "murmur", "xxhash"};
+
+// Distinct words of the corpus, then distinct pairs and triples of consecutive words, up to count keys
+vector<string> englishKeys(size_t count) {
+    vector<string> words;
+    FlatHashTable seen(1024);
+    {
+        MappedFile file("alice_in_wonderland.txt");
+        istringstream text(string(file.data(), file.size()));
+        string word;
+        while (text >> word) {
+            word.erase(remove_if(word.begin(), word.end(), ::ispunct), word.end());
+            transform(word.begin(), word.end(), word.begin(), ::tolower);
+            if (!word.empty()) {
+                words.push_back(word);
+            }
+        }
+    }
+
+    vector<string> keys;
+    for (size_t n = 1; n <= 3 && keys.size() < count; ++n) {
+        for (size_t i = 0; i + n <= words.size() && keys.size() < count; ++i) {
+            string key = words[i];
+            for (size_t j = 1; j < n; ++j) {
+                key += " " + words[i + j];
+            }
+            if (seen.find(key) == -1) {
+                seen.insert(key, 1);
+                keys.push_back(key);
+            }
+        }
+    }
+    return keys;
+}
+
+vector<string> urlKeys(size_t count, mt19937_64& gen) {
+    const char* const sections[] = {"news", "shop/item", "user", "static/img", "api/v2/orders"};
+    vector<string> keys;
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back("https://www.site" + to_string(gen() % 500) + ".com/" + sections[gen() % 5] + "/" + to_string(gen() % 100000) + "?id=" + to_string(i));
+    }
+    return keys;
+}
+
+vector<string> randomByteKeys(size_t count, mt19937_64& gen) {
+    vector<string> keys;
+    for (size_t i = 0; i < count; ++i) {
+        string key(8 + gen() % 25, '\0');
+        for (char& c : key) {
+            c = static_cast<char>(gen());
+        }
+        // the counter suffix keeps every key distinct
+        key += to_string(i);
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// Two families built to collide: strings of "Aa"/"BB" blocks, which all share one value under
+// the classic h * 31 + c polynomial, and strings of 8 byte blocks that differ only in the top bit
+// of each block
+vector<string> adversarialKeys(size_t count) {
+    vector<string> keys;
+    for (size_t i = 0; i < count; ++i) {
+        size_t bits = i / 2;
+        string key;
+        for (int block = 0; block < 20; ++block) {
+            bool set = (bits >> block) & 1;
+            if (i % 2 == 0) {
+                key += set ? "BB" : "Aa";
+            } else {
+                key += "collide";
+                key += static_cast<char>(set ? 0xe1 : 0x61);
+            }
+        }
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+double percentile(vector<double>& samples, double fraction) {
+    size_t index = min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+    nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+// operations timed between each pair of clock reads, so the clock's own cost is spread thin
+const size_t TIMING_BATCH = 64;
+
+// Calls op on every key, TIMING_BATCH keys per clock reading, and returns the mean latency of
+// each batch in nanoseconds per operation
+template <typename Operation>
+vector<double> timeBatches(const vector<string>& keys, Operation op) {
+    vector<double> samples;
+    samples.reserve(keys.size() / TIMING_BATCH + 1);
+    for (size_t first = 0; first < keys.size(); first += TIMING_BATCH) {
+        size_t last = min(keys.size(), first + TIMING_BATCH);
+        auto start = chrono::steady_clock::now();
+        for (size_t i = first; i < last; ++i) {
+            op(keys[i]);
+        }
+        auto stop = chrono::steady_clock::now();
+        samples.push_back(chrono::duration<double, nano>(stop - start).count() / (last - first));
+    }
+    return samples;
+}
+
+// Mean and longest distance from home over the occupied slots, in extra slots probed
+pair<double, int> probeSummary(FlatHashTable& table) {
+    vector<int> lengths = table.calculateProbeLengths();
+    if (lengths.empty()) {
+        return {0, 0};
+    }
+    double sum = accumulate(lengths.begin(), lengths.end(), 0.0);
+    return {sum / lengths.size(), *max_element(lengths.begin(), lengths.end())};
+}
+
+// Runs every hash function over every key distribution, key count and load factor on the
+// chained table, and the flat table once per distribution and key count, and writes one CSV row
+// per run to out. Chained rows leave the probe columns empty and flat rows the chain columns.
+void runBenchmarks(ostream& out) {
+    mt19937_64 gen(5800);
+    const size_t keyCounts[] = {1000, 10000, 100000};
+    const double loadFactors[] = {0.5, 1, 2, 4};
+
+    out << "hash,table,distribution,key_count,buckets,load_factor,hash_ns_per_key,hash_gb_per_s,"
+        << "insert_p50_ns,insert_p99_ns,find_p50_ns,find_p99_ns,delete_p50_ns,delete_p99_ns,"
+        << "chain_variance,max_chain,mean_probe,max_probe" << endl;
+
+    // keeps find results alive so the lookups are not optimised away
+    long long findSink = 0;
+
+    for (size_t keyCount : keyCounts) {
+        vector<pair<string, vector<string>>> distributions = {
+            {"english", englishKeys(keyCount)},
+            {"urls", urlKeys(keyCount, gen)},
+            {"random_bytes", randomByteKeys(keyCount, gen)},
+            {"adversarial", adversarialKeys(keyCount)},
+        };
+
+        for (auto& [distribution, keys] : distributions) {
+            size_t bytes = 0;
+            for (const string& key : keys) {
+                bytes += key.size();
+            }
+
+            for (double loadFactor : loadFactors) {
+                int buckets = max(1, static_cast<int>(keys.size() / loadFactor));
+
+                for (int kind = RANDOM_HASH; kind <= XX_HASH; ++kind) {
+                    HashTable table(buckets, 0, static_cast<HashKind>(kind));
+
+                    // hash throughput on its own, over several passes so short runs are measurable
+                    const int passes = 10;
+                    uint32_t sink = 0;
+                    auto start = chrono::steady_clock::now();
+                    for (int pass = 0; pass < passes; ++pass) {
+                        for (const string& key : keys) {
+                            sink += table.hashFunction(key);
+                        }
+                    }
+                    double hashNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+                    volatile uint32_t keepSink = sink;
+                    (void)keepSink;
+
+                    vector<double> inserts = timeBatches(keys, [&](const string& key) { table.insert(key, 1); });
+                    ChainStats full = table.stats();
+                    vector<double> finds = timeBatches(keys, [&](const string& key) { findSink += table.find(key); });
+                    vector<double> deletes = timeBatches(keys, [&](const string& key) { table.deleteKey(key); });
+
+                    out << HASH_NAMES[kind] << "," << "chained" << "," << distribution << "," << keys.size() << ","
+                        << buckets << "," << loadFactor << ","
+                        << hashNs / (passes * keys.size()) << "," << passes * bytes / hashNs << ","
+                        << percentile(inserts, 0.5) << "," << percentile(inserts, 0.99) << ","
+                        << percentile(finds, 0.5) << "," << percentile(finds, 0.99) << ","
+                        << percentile(deletes, 0.5) << "," << percentile(deletes, 0.99) << ","
+                        << full.variance << "," << full.longestChain << ",," << endl;
+                }
+            }
+
+            // the flat table keeps its own load factor, so size it to hold every key without growing
+            FlatHashTable flat(static_cast<int>(keys.size() * 8 / 7 + 1));
+            uint32_t seed = static_cast<uint32_t>(gen());
+
+            const int passes = 10;
+            uint32_t hashSink = 0;
+            auto start = chrono::steady_clock::now();
+            for (int pass = 0; pass < passes; ++pass) {
+                for (const string& key : keys) {
+                    hashSink += murmurHash3(key, seed);
+                }
+            }
+            double hashNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            volatile uint32_t keepSink = hashSink;
+            (void)keepSink;
+
+            vector<double> inserts = timeBatches(keys, [&](const string& key) { flat.insert(key, 1); });
+            size_t slots = flat.capacity();
+            auto [meanProbe, maxProbe] = probeSummary(flat);
+            vector<double> finds = timeBatches(keys, [&](const string& key) { findSink += flat.find(key); });
+            vector<double> deletes = timeBatches(keys, [&](const string& key) { flat.deleteKey(key); });
+
+            out << "murmur" << "," << "flat" << "," << distribution << "," << keys.size() << ","
+                << slots << "," << static_cast<double>(keys.size()) / slots << ","
+                << hashNs / (passes * keys.size()) << "," << passes * bytes / hashNs << ","
+                << percentile(inserts, 0.5) << "," << percentile(inserts, 0.99) << ","
+                << percentile(finds, 0.5) << "," << percentile(finds, 0.99) << ","
+                << percentile(deletes, 0.5) << "," << percentile(deletes, 0.99) << ","
+                << ",," << meanProbe << "," << maxProbe << endl;
+        }
+    }
+
+    volatile long long keepFinds = findSink;
+    (void)keepFinds;
+}
+
+// Inserts enough keys with the same home slot to push a probe run past MAX_DISTANCE, then
+// checks that the table grew instead of wrapping a control byte, and that every key, present
+// or absent, is still looked up correctly.
+bool testLongProbeRun() {
+    FlatHashTable table(512);
+    size_t home = 0;
+
+    vector<string> colliding;
+    vector<string> absent;
+    for (int i = 0; colliding.size() < MAX_DISTANCE || absent.size() < 16; ++i) {
+        string key = "key" + to_string(i);
+        if ((murmurHash3(key, table.seed) & table.mask) == home) {
+            (colliding.size() < MAX_DISTANCE ? colliding : absent).push_back(key);
+        }
+    }
+
+    for (size_t i = 0; i < colliding.size(); ++i) {
+        table.insert(colliding[i], static_cast<int>(i) + 1);
+    }
+
+    bool ok = true;
+    for (int length : table.calculateProbeLengths()) {
+        ok = ok && length + 1 < MAX_DISTANCE;
+    }
+    for (size_t i = 0; i < colliding.size(); ++i) {
+        ok = ok && table.find(colliding[i]) == static_cast<int>(i) + 1;
+    }
+    for (const string& key : absent) {
+        ok = ok && table.find(key) == -1;
+    }
+    for (size_t i = 0; i < colliding.size(); i += 2) {
+        ok = ok && table.deleteKey(colliding[i]);
+    }
+    for (size_t i = 0; i < colliding.size(); ++i) {
+        ok = ok && table.find(colliding[i]) == ((i % 2) ? static_cast<int>(i) + 1 : -1);
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    // HashTable --test runs the self-checks and reports through the exit code
+    if (argc > 1 && string(argv[1]) == "--test") {
+        bool ok = testLongProbeRun();
+        cout << "long probe run: " << (ok ? "ok" : "FAILED") << endl;
+        return ok ? 0 : 1;
+    }
+
+    // HashTable --bench [results.csv] runs the benchmark suite instead of the Alice demo
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        if (argc > 2) {
+            ofstream results(argv[2]);
+            runBenchmarks(results);
+        } else {
+            runBenchmarks(cout);
+        }
+        return 0;
+    }
+
+    int m;
+    cout << "Enter the size of the Hash table: ";
+    cin >> m;
+
+    // keep the table at m buckets so the histogram shows chains for the requested size
+    HashTable hashTable = HashTable(m, 0);
+
+    loadFileIntoHashTable("alice_in_wonderland.txt", hashTable);
+
+    cout << "\nReading Alice in Wonderland..." << endl;
+
+    cout << "\nHistogram of Collision Lists' Lengths:" << endl;
+    hashTable.printCollisionsHistogram();
+
+    cout << "\nVariance of collision list lengths: " << hashTable.calculateVariance() << "\n" << endl;
+
+    hashTable.printLongestLists();
+
+    FlatHashTable flatTable = FlatHashTable(m);
+
+    loadFileIntoHashTableParallel("alice_in_wonderland.txt", flatTable, max(1u, thread::hardware_concurrency()));
+
+    cout << "\nReading Alice in Wonderland into the open addressing table..." << endl;
+
+    cout << "\nHistogram of Probe Lengths:" << endl;
+    flatTable.printProbeLengthsHistogram();
+
+    cout << "\nVariance of probe lengths: " << flatTable.calculateVariance() << endl;
+
+    ConcurrentHashTable sharedTable(m);
+
+    loadFileIntoConcurrentHashTable("alice_in_wonderland.txt", sharedTable, max(1u, thread::hardware_concurrency()));
+
+    cout << "\nOccurrences of \"alice\" counted by threads sharing one table: " << sharedTable.find("alice") << endl;
 }
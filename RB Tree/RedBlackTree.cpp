@@ -1,265 +1,2564 @@
 #include <iostream>
+#include <algorithm>
 #include <vector>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <fstream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BPLUS_TREE_SSE2 1
+#endif
+#include <cstring>
+#include <cstdio>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
-const string RED = "red";
-const string BLACK = "black";
+// Nodes are addressed by their position in the tree's node pool. Index 0 is the shared
+// black sentinel that stands in for every missing child and the root's parent.
+typedef uint32_t NodeIndex;
+const NodeIndex NIL = 0;
 
+// the color lives in the top bit of parentAndColor, the parent index in the other 31
+const uint32_t RED_BIT = 0x80000000u;
+const uint32_t PARENT_MASK = 0x7fffffffu;
+
+// The pool grows in chunks that double in size, so nodes never move once allocated and
+// references into the tree stay valid across inserts. 32 chunks cover every 31-bit index.
+const int FIRST_CHUNK_SHIFT = 5;
+const uint32_t FIRST_CHUNK_SIZE = 1u << FIRST_CHUNK_SHIFT;
+const int MAX_CHUNKS = 32;
+
+// A file written by RedBlackTree::save starts with a TreeFileHeader padded to
+// TREE_FILE_HEADER_SIZE bytes. The nodes follow in breadth-first order with their links
+// renumbered to match, stored exactly as they sit in memory (native byte order). Slot 0 is
+// the sentinel, so the node array can be searched straight out of a memory mapping.
+const char TREE_FILE_MAGIC[8] = {'R', 'B', 'T', 'R', 'E', 'E', '0', '1'};
+const size_t TREE_FILE_HEADER_SIZE = 64;
+
+struct TreeFileHeader {
+    char magic[8];
+    // sizes of the node, key and value, so a file written for other types is rejected
+    uint32_t nodeSize;
+    uint32_t keySize;
+    uint32_t valueSize;
+    NodeIndex root;
+    uint64_t count;
+};
+
+// Read-only memory mapping of a whole file, trimmed down from the one in HashTable.cpp to
+// what RedBlackTreeView needs. Only the view is kept: the file and mapping handles are
+// closed as soon as it exists. data() is null when the file is missing or empty.
+class MappedFile {
+    public:
+        MappedFile(const string& filename);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return bytes; }
+        size_t size() const { return length; }
+
+    private:
+        const char* bytes;
+        size_t length;
+};
+
+#ifdef _WIN32
+MappedFile::MappedFile(const string& filename) : bytes(nullptr), length(0) {
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            length = bytes ? static_cast<size_t>(fileSize.QuadPart) : 0;
+            // the view keeps the mapping alive on its own
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) UnmapViewOfFile(bytes);
+}
+#else
+MappedFile::MappedFile(const string& filename) : bytes(nullptr), length(0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0) {
+        return;
+    }
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            bytes = static_cast<const char*>(address);
+            length = info.st_size;
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+}
+#endif
+
+// Checks the header of a file of TreeNode records and returns its node array, or null. Only
+// constant-time checks are made: the header and file length, the sentinel, and the root, which
+// save always numbers 1. The links are left to treeFileLinksValid.
+template <typename TreeNode, typename K, typename V>
+const TreeNode* treeFileNodes(const MappedFile& file, NodeIndex& root, size_t& count) {
+    if (!file.data() || file.size() < TREE_FILE_HEADER_SIZE) {
+        return nullptr;
+    }
+    TreeFileHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, TREE_FILE_MAGIC, sizeof(header.magic)) != 0 || header.nodeSize != sizeof(TreeNode)
+        || header.keySize != sizeof(K) || header.valueSize != sizeof(V)
+        || header.count >= PARENT_MASK || header.root != (header.count == 0 ? NIL : 1)
+        || file.size() < TREE_FILE_HEADER_SIZE + (header.count + 1) * sizeof(TreeNode)) {
+        return nullptr;
+    }
+
+    const TreeNode* nodes = reinterpret_cast<const TreeNode*>(file.data() + TREE_FILE_HEADER_SIZE);
+    // the sentinel is black with no links and an empty subtree, and the root is black
+    if (nodes[NIL].left != NIL || nodes[NIL].right != NIL || nodes[NIL].parentAndColor != 0 || nodes[NIL].size != 0
+        || (header.root != NIL && nodes[header.root].parentAndColor != 0)) {
+        return nullptr;
+    }
+
+    root = header.root;
+    count = header.count;
+    return nodes;
+}
+
+// Checks every node of a tree file in one pass from the last node back to the root: links in
+// range and agreeing in both directions, subtree sizes that add up, and the red-black rules.
+// save numbers nodes breadth-first, so a child always comes after its parent; holding files
+// to that guarantees that every walk down or up the tree ends.
+template <typename TreeNode>
+bool treeFileLinksValid(const TreeNode* nodes, size_t count) {
+    NodeIndex last = static_cast<NodeIndex>(count);
+    // black nodes on each path from a node down to the sentinel, which counts as 0
+    vector<uint8_t> blackHeight(count + 1, 0);
+    for (NodeIndex x = last; x != NIL; x--) {
+        NodeIndex left = nodes[x].left;
+        NodeIndex right = nodes[x].right;
+        NodeIndex parent = nodes[x].parentAndColor & PARENT_MASK;
+        bool red = nodes[x].parentAndColor & RED_BIT;
+        if ((left != NIL && (left <= x || left > last || (nodes[left].parentAndColor & PARENT_MASK) != x))
+            || (right != NIL && (right <= x || right > last || (nodes[right].parentAndColor & PARENT_MASK) != x))
+            || (left != NIL && left == right)
+            || (x == 1 ? parent != NIL : (parent == NIL || parent >= x || (nodes[parent].left != x && nodes[parent].right != x)))
+            || nodes[x].size != static_cast<uint64_t>(nodes[left].size) + nodes[right].size + 1
+            || (red && ((nodes[left].parentAndColor & RED_BIT) || (nodes[right].parentAndColor & RED_BIT)))
+            || blackHeight[left] != blackHeight[right]) {
+            return false;
+        }
+        blackHeight[x] = blackHeight[left] + (red ? 0 : 1);
+    }
+    return count == 0 || nodes[1].size == count;
+}
+
+// Walks a tree file whose links treeFileLinksValid accepted in key order, checking that every
+// key comes strictly after the one before it
+template <typename TreeNode, typename Compare>
+bool treeFileKeysOrdered(const TreeNode* nodes, size_t count, const Compare& comp) {
+    NodeIndex previous = NIL;
+    NodeIndex x = (count == 0) ? NIL : 1;
+    while (x != NIL && nodes[x].left != NIL) {
+        x = nodes[x].left;
+    }
+    while (x != NIL) {
+        if (previous != NIL && !comp(nodes[previous].value().first, nodes[x].value().first)) {
+            return false;
+        }
+        previous = x;
+        if (nodes[x].right != NIL) {
+            x = nodes[x].right;
+            while (nodes[x].left != NIL) {
+                x = nodes[x].left;
+            }
+        }
+        else {
+            NodeIndex y = nodes[x].parentAndColor & PARENT_MASK;
+            while (y != NIL && x == nodes[y].right) {
+                x = y;
+                y = nodes[y].parentAndColor & PARENT_MASK;
+            }
+            x = y;
+        }
+    }
+    return true;
+}
+
+// Inputs below this many elements per thread are sorted on a single thread
+const size_t PARALLEL_SORT_GRAIN = 1 << 16;
+// Lookups searchBatch keeps in flight at once. Each round advances every one of them a level
+// after prefetching the nodes they will read next, so the cache misses overlap.
+const size_t SEARCH_BATCH_GROUP = 16;
+// Below this many keys the tree stays in cache, there is no latency to hide, and plain
+// one-at-a-time searches are faster
+const size_t SEARCH_BATCH_MIN_SIZE = 1 << 16;
+// unionWith and subtract fall back to per-key updates when the other tree is this much smaller
+const size_t SMALL_MERGE_FACTOR = 16;
+
+// Stable sort that splits large inputs into one run per hardware thread, sorts the runs
+// concurrently, then merges neighbouring runs pairwise, also in parallel.
+template <typename T, typename Less>
+void parallelSort(vector<T>& items, Less less) {
+    size_t threadCount = std::min<size_t>(max(1u, thread::hardware_concurrency()), items.size() / PARALLEL_SORT_GRAIN);
+    if (threadCount <= 1) {
+        stable_sort(items.begin(), items.end(), less);
+        return;
+    }
+
+    vector<size_t> bounds;
+    for (size_t t = 0; t <= threadCount; t++) {
+        bounds.push_back(items.size() * t / threadCount);
+    }
+
+    vector<thread> workers;
+    for (size_t t = 0; t < threadCount; t++) {
+        workers.emplace_back([&items, &bounds, less, t]() {
+            stable_sort(items.begin() + bounds[t], items.begin() + bounds[t + 1], less);
+        });
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    while (bounds.size() > 2) {
+        vector<size_t> merged;
+        workers.clear();
+        for (size_t t = 0; t + 2 < bounds.size(); t += 2) {
+            workers.emplace_back([&items, &bounds, less, t]() {
+                inplace_merge(items.begin() + bounds[t], items.begin() + bounds[t + 1], items.begin() + bounds[t + 2], less);
+            });
+            merged.push_back(bounds[t]);
+        }
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        // an odd run out carries over to the next round unmerged
+        if (bounds.size() % 2 == 0) {
+            merged.push_back(bounds[bounds.size() - 2]);
+        }
+        merged.push_back(bounds.back());
+        bounds = merged;
+    }
+}
+
+// The key/value pair is kept in raw storage so that only live nodes hold a constructed
+// value; the sentinel and free slots just use the links.
+template <typename Value>
 class Node {
     public:
-        int key;
-        string color;
-        Node* parent;
-        Node* left;
-        Node* right;
+        NodeIndex left;
+        NodeIndex right;
+        uint32_t parentAndColor;
+        // number of nodes in the subtree rooted here; 0 for the sentinel
+        uint32_t size;
+        alignas(Value) unsigned char storage[sizeof(Value)];
+
+        Value& value() { return *reinterpret_cast<Value*>(storage); }
+        const Value& value() const { return *reinterpret_cast<const Value*>(storage); }
+};
+
+template <typename K, typename V, typename Compare = less<K>, typename Alloc = allocator<pair<const K, V>>>
+class RedBlackTree {
+    public:
+        typedef K key_type;
+        typedef V mapped_type;
+        typedef pair<const K, V> value_type;
+
+        // Bidirectional iterator over the nodes in key order, stepping through parent links.
+        // end() sits on the sentinel, and stepping back from it lands on the largest key.
+        template <typename Ref>
+        class Iterator {
+            public:
+                typedef bidirectional_iterator_tag iterator_category;
+                typedef pair<const K, V> value_type;
+                typedef ptrdiff_t difference_type;
+                typedef typename remove_reference<Ref>::type* pointer;
+                typedef Ref reference;
+
+                Iterator() : tree(nullptr), x(NIL) {}
+                Iterator(const RedBlackTree* tree, NodeIndex x) : tree(tree), x(x) {}
+                // lets an iterator convert to a const_iterator, but not the other way
+                template <typename R, typename = typename enable_if<is_convertible<R, Ref>::value>::type>
+                Iterator(const Iterator<R>& other) : tree(other.tree), x(other.x) {}
+
+                Ref operator*() const { return tree->node(x).value(); }
+                pointer operator->() const { return &tree->node(x).value(); }
+                Iterator& operator++() { x = tree->successor(x); return *this; }
+                Iterator operator++(int) { Iterator old = *this; x = tree->successor(x); return old; }
+                Iterator& operator--() { x = (x == NIL) ? tree->max(tree->root) : tree->predecessor(x); return *this; }
+                Iterator operator--(int) { Iterator old = *this; --*this; return old; }
+                bool operator==(const Iterator& other) const { return x == other.x; }
+                bool operator!=(const Iterator& other) const { return x != other.x; }
+                NodeIndex index() const { return x; }
+
+            private:
+                template <typename R>
+                friend class Iterator;
+
+                const RedBlackTree* tree;
+                NodeIndex x;
+        };
+        typedef Iterator<value_type&> iterator;
+        typedef Iterator<const value_type&> const_iterator;
+
+        // A pair of iterators usable in a range-for
+        template <typename It>
+        class IteratorRange {
+            public:
+                IteratorRange(It first, It last) : first(first), last(last) {}
+                It begin() const { return first; }
+                It end() const { return last; }
+
+            private:
+                It first;
+                It last;
+        };
+
+        NodeIndex root;
+
+        RedBlackTree(const Compare& comp = Compare(), const Alloc& alloc = Alloc());
+        RedBlackTree(RedBlackTree&& other);
+        RedBlackTree& operator=(RedBlackTree&& other);
+        RedBlackTree(const RedBlackTree&) = delete;
+        RedBlackTree& operator=(const RedBlackTree&) = delete;
+        ~RedBlackTree();
+
+        NodeIndex search(NodeIndex x, const K& target) const { return searchFor(x, target); }
+        // heterogeneous lookup, only offered when the comparator is transparent like less<>
+        template <typename KK, typename C = Compare, typename = typename C::is_transparent>
+        NodeIndex search(NodeIndex x, const KK& target) const { return searchFor(x, target); }
+        NodeIndex find(const K& target) const { return searchFor(root, target); }
+        template <typename KK, typename C = Compare, typename = typename C::is_transparent>
+        NodeIndex find(const KK& target) const { return searchFor(root, target); }
+
+        // results[i] = find(targets[i]) for each of the n targets, interleaving the descents
+        void searchBatch(const K* targets, size_t n, NodeIndex* results) const;
+
+        NodeIndex min(NodeIndex x) const;
+        NodeIndex max(NodeIndex x) const;
+        NodeIndex successor(NodeIndex x) const;
+        NodeIndex predecessor(NodeIndex x) const;
+
+        // Order statistics: select(k) is the node with exactly k smaller keys (NIL when k is
+        // out of range), and rank(key) counts the keys less than key, present or not.
+        NodeIndex select(size_t k) const;
+        size_t rank(const K& target) const;
+        size_t subtreeSize(NodeIndex x) const { return node(x).size; }
+        // how many links a search follows from the root to reach x
+        size_t depth(NodeIndex x) const;
+
+        // Keys are unique. Each of these returns the node holding the key and whether it
+        // was newly inserted; an existing entry is left untouched.
+        template <typename... Args>
+        pair<NodeIndex, bool> emplace(Args&&... args);
+        template <typename... Args>
+        pair<NodeIndex, bool> tryEmplace(const K& key, Args&&... args) { return tryEmplaceKey(key, forward<Args>(args)...); }
+        template <typename... Args>
+        pair<NodeIndex, bool> tryEmplace(K&& key, Args&&... args) { return tryEmplaceKey(move(key), forward<Args>(args)...); }
+        template <typename KK, typename VV>
+        pair<NodeIndex, bool> insert(KK&& key, VV&& value) { return tryEmplace(forward<KK>(key), forward<VV>(value)); }
+        V& operator[](const K& key) { return value(tryEmplace(key).first); }
+        V& operator[](K&& key) { return value(tryEmplace(move(key)).first); }
+
+        void deleteNode(NodeIndex target);
+        size_t erase(const K& key);
+        void clear();
+
+        // Writes the tree to path in the format described at TreeFileHeader, or reads one
+        // back, replacing the contents. Loading copies the node array into the pool in one
+        // pass with no rebalancing. Both need trivially copyable keys and values, and return
+        // false, leaving the tree untouched, on I/O errors, a file written for different types,
+        // or a truncated or corrupt file.
+        bool save(const string& path) const;
+        bool load(const string& path);
+
+        // Bulk operations. build replaces the contents in O(n) once the entries are sorted,
+        // sorting them first (in parallel when large) unless told they already are; the
+        // first of any duplicate keys wins. The set operations keep this tree's value for
+        // shared keys and relink the surviving nodes into a balanced tree in O(n + m).
+        void build(vector<pair<K, V>> entries, bool sorted = false);
+        void unionWith(RedBlackTree&& other);
+        void intersectWith(const RedBlackTree& other);
+        void subtract(const RedBlackTree& other);
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        iterator begin() { return iterator(this, min(root)); }
+        iterator end() { return iterator(this, NIL); }
+        const_iterator begin() const { return const_iterator(this, min(root)); }
+        const_iterator end() const { return const_iterator(this, NIL); }
+        reverse_iterator<iterator> rbegin() { return reverse_iterator<iterator>(end()); }
+        reverse_iterator<iterator> rend() { return reverse_iterator<iterator>(begin()); }
+        // first key not less than / greater than the target
+        iterator lowerBound(const K& target) { return iterator(this, lowerBoundIndex(target)); }
+        iterator upperBound(const K& target) { return iterator(this, upperBoundIndex(target)); }
+        const_iterator lowerBound(const K& target) const { return const_iterator(this, lowerBoundIndex(target)); }
+        const_iterator upperBound(const K& target) const { return const_iterator(this, upperBoundIndex(target)); }
+        // every entry with lo <= key < hi, in order
+        IteratorRange<iterator> range(const K& lo, const K& hi);
+        IteratorRange<const_iterator> range(const K& lo, const K& hi) const;
+
+        void inlineWalk(NodeIndex x) const;
+        void layeredWalk(NodeIndex x) const;
+
+        const K& key(NodeIndex x) const { return node(x).value().first; }
+        V& value(NodeIndex x) { return node(x).value().second; }
+        const V& value(NodeIndex x) const { return node(x).value().second; }
+        bool isRed(NodeIndex x) const { return node(x).parentAndColor & RED_BIT; }
+
+    private:
+        typedef Node<value_type> TreeNode;
+        typedef typename allocator_traits<Alloc>::template rebind_alloc<TreeNode> NodeAlloc;
+
+        Compare comp;
+        Alloc alloc;
+        NodeAlloc nodeAlloc;
+        // chunks[c] holds FIRST_CHUNK_SIZE << c nodes; slot 0 of chunk 0 is the sentinel
+        TreeNode* chunks[MAX_CHUNKS];
+        int chunkCount;
+        NodeIndex nextIndex;
+        // released slots are chained through their left index for reuse
+        NodeIndex freeList;
+        size_t count;
+
+        TreeNode& node(NodeIndex x) const {
+            uint32_t position = x + FIRST_CHUNK_SIZE;
+            int high = 31 - __builtin_clz(position);
+            return chunks[high - FIRST_CHUNK_SHIFT][position - (1u << high)];
+        }
+
+        NodeIndex& left(NodeIndex x) { return node(x).left; }
+        NodeIndex& right(NodeIndex x) { return node(x).right; }
+        NodeIndex parent(NodeIndex x) const { return node(x).parentAndColor & PARENT_MASK; }
+        void setParent(NodeIndex x, NodeIndex p) { node(x).parentAndColor = (node(x).parentAndColor & RED_BIT) | p; }
+        void setRed(NodeIndex x) { node(x).parentAndColor |= RED_BIT; }
+        void setBlack(NodeIndex x) { node(x).parentAndColor &= PARENT_MASK; }
+
+        template <typename KK>
+        NodeIndex searchFor(NodeIndex x, const KK& target) const;
+        NodeIndex lowerBoundIndex(const K& target) const;
+        NodeIndex upperBoundIndex(const K& target) const;
+        template <typename KK, typename... Args>
+        pair<NodeIndex, bool> tryEmplaceKey(KK&& key, Args&&... args);
+        void link(NodeIndex z, NodeIndex y, bool goesLeft);
+
+        void addChunk();
+        NodeIndex allocate();
+        void release(NodeIndex x);
+        void destroyNodes();
+        void freeChunks(int keep);
+        void swapWith(RedBlackTree& other);
+
+        vector<NodeIndex> inOrder() const;
+        void rebuild(const vector<NodeIndex>& order);
+        NodeIndex relink(const vector<NodeIndex>& order, size_t lo, size_t hi, NodeIndex p, int depth, int redDepth);
+        void destroyNode(NodeIndex x);
+
+        void leftRotate(NodeIndex x);
+        void rightRotate(NodeIndex y);
+        void insertFixup(NodeIndex z);
+        void deleteFixup(NodeIndex x);
+        void transplant(NodeIndex u, NodeIndex v);
+};
+
+template <typename K, typename V, typename Compare, typename Alloc>
+RedBlackTree<K, V, Compare, Alloc>::RedBlackTree(const Compare& comp, const Alloc& alloc)
+    : root(NIL), comp(comp), alloc(alloc), nodeAlloc(alloc), chunkCount(0), nextIndex(0), freeList(NIL), count(0) {
+    addChunk();
+    NodeIndex sentinel = allocate();
+    node(sentinel).parentAndColor = NIL;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+RedBlackTree<K, V, Compare, Alloc>::RedBlackTree(RedBlackTree&& other) : RedBlackTree(other.comp, other.alloc) {
+    swapWith(other);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+RedBlackTree<K, V, Compare, Alloc>& RedBlackTree<K, V, Compare, Alloc>::operator=(RedBlackTree&& other) {
+    if (this != &other) {
+        clear();
+        swapWith(other);
+    }
+    return *this;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+RedBlackTree<K, V, Compare, Alloc>::~RedBlackTree() {
+    destroyNodes();
+    freeChunks(0);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::swapWith(RedBlackTree& other) {
+    swap(root, other.root);
+    swap(comp, other.comp);
+    swap(alloc, other.alloc);
+    swap(nodeAlloc, other.nodeAlloc);
+    swap(chunks, other.chunks);
+    swap(chunkCount, other.chunkCount);
+    swap(nextIndex, other.nextIndex);
+    swap(freeList, other.freeList);
+    swap(count, other.count);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::addChunk() {
+    chunks[chunkCount] = allocator_traits<NodeAlloc>::allocate(nodeAlloc, FIRST_CHUNK_SIZE << chunkCount);
+    chunkCount++;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::allocate() {
+    NodeIndex x;
+    if (freeList != NIL) {
+        x = freeList;
+        freeList = node(x).left;
+    }
+    else {
+        // slots handed out so far fill every chunk exactly up to capacity
+        if (nextIndex == (FIRST_CHUNK_SIZE << chunkCount) - FIRST_CHUNK_SIZE) {
+            addChunk();
+        }
+        x = nextIndex++;
+    }
+    node(x).left = NIL;
+    node(x).right = NIL;
+    node(x).parentAndColor = NIL;
+    node(x).size = 0;
+    return x;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::release(NodeIndex x) {
+    node(x).left = freeList;
+    freeList = x;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::destroyNodes() {
+    // successor only reads links, so each value can be destroyed as the walk passes it
+    if (root != NIL) {
+        for (NodeIndex x = min(root); x != NIL; x = successor(x)) {
+            allocator_traits<Alloc>::destroy(alloc, &node(x).value());
+        }
+    }
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::freeChunks(int keep) {
+    while (chunkCount > keep) {
+        chunkCount--;
+        allocator_traits<NodeAlloc>::deallocate(nodeAlloc, chunks[chunkCount], FIRST_CHUNK_SIZE << chunkCount);
+    }
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::clear() {
+    destroyNodes();
+    freeChunks(1);
+    root = NIL;
+    nextIndex = 1;
+    freeList = NIL;
+    count = 0;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+bool RedBlackTree<K, V, Compare, Alloc>::save(const string& path) const {
+    static_assert(is_trivially_copyable<K>::value && is_trivially_copyable<V>::value, "save needs trivially copyable keys and values");
+
+    // breadth-first, so the top levels that every search reads share the first pages
+    vector<NodeIndex> order;
+    order.reserve(count + 1);
+    order.push_back(NIL);
+    if (root != NIL) {
+        order.push_back(root);
+    }
+    for (size_t i = 1; i < order.size(); i++) {
+        if (node(order[i]).left != NIL) {
+            order.push_back(node(order[i]).left);
+        }
+        if (node(order[i]).right != NIL) {
+            order.push_back(node(order[i]).right);
+        }
+    }
+    vector<NodeIndex> renumbered(nextIndex, NIL);
+    for (size_t i = 0; i < order.size(); i++) {
+        renumbered[order[i]] = static_cast<NodeIndex>(i);
+    }
+
+    ofstream out(path, ios::binary);
+    TreeFileHeader header;
+    memcpy(header.magic, TREE_FILE_MAGIC, sizeof(header.magic));
+    header.nodeSize = sizeof(TreeNode);
+    header.keySize = sizeof(K);
+    header.valueSize = sizeof(V);
+    header.root = renumbered[root];
+    header.count = count;
+    char padded[TREE_FILE_HEADER_SIZE] = {};
+    memcpy(padded, &header, sizeof(header));
+    out.write(padded, sizeof(padded));
+
+    // the sentinel is written clean, since fixups leave a stale parent in it
+    TreeNode record;
+    memset(&record, 0, sizeof(record));
+    out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    for (size_t i = 1; i < order.size(); i++) {
+        const TreeNode& x = node(order[i]);
+        record.left = renumbered[x.left];
+        record.right = renumbered[x.right];
+        record.parentAndColor = (x.parentAndColor & RED_BIT) | renumbered[x.parentAndColor & PARENT_MASK];
+        record.size = x.size;
+        memcpy(record.storage, x.storage, sizeof(record.storage));
+        out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+    return out.good();
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+bool RedBlackTree<K, V, Compare, Alloc>::load(const string& path) {
+    static_assert(is_trivially_copyable<K>::value && is_trivially_copyable<V>::value, "load needs trivially copyable keys and values");
+
+    MappedFile file(path);
+    NodeIndex fileRoot;
+    size_t fileCount;
+    const TreeNode* records = treeFileNodes<TreeNode, K, V>(file, fileRoot, fileCount);
+    // the loaded tree is searched and rebalanced by later calls, so all of it is checked first
+    if (!records || !treeFileLinksValid(records, fileCount) || !treeFileKeysOrdered(records, fileCount, comp)) {
+        return false;
+    }
+
+    clear();
+    size_t total = fileCount + 1;
+    while ((FIRST_CHUNK_SIZE << chunkCount) - FIRST_CHUNK_SIZE < total) {
+        addChunk();
+    }
+    // the file's indices are dense, so each chunk is one straight copy
+    for (int c = 0; c < chunkCount; c++) {
+        size_t chunkStart = (FIRST_CHUNK_SIZE << c) - FIRST_CHUNK_SIZE;
+        if (chunkStart >= total) {
+            break;
+        }
+        size_t chunkLength = std::min<size_t>(FIRST_CHUNK_SIZE << c, total - chunkStart);
+        memcpy(static_cast<void*>(chunks[c]), records + chunkStart, chunkLength * sizeof(TreeNode));
+    }
+
+    root = fileRoot;
+    count = fileCount;
+    nextIndex = static_cast<NodeIndex>(total);
+    freeList = NIL;
+    return true;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+vector<NodeIndex> RedBlackTree<K, V, Compare, Alloc>::inOrder() const {
+    vector<NodeIndex> order;
+    order.reserve(count);
+    for (NodeIndex x = min(root); x != NIL; x = successor(x)) {
+        order.push_back(x);
+    }
+    return order;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::destroyNode(NodeIndex x) {
+    allocator_traits<Alloc>::destroy(alloc, &node(x).value());
+    release(x);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::rebuild(const vector<NodeIndex>& order) {
+    // Splitting at the midpoint fills every level but the deepest, which sits at depth
+    // floor(log2(n + 1)). Making only that partial level red keeps every black height equal.
+    size_t n = order.size();
+    int fullLevels = 0;
+    while (((size_t(2) << fullLevels) - 1) <= n) {
+        fullLevels++;
+    }
+    int redDepth = ((size_t(1) << fullLevels) - 1 == n) ? -1 : fullLevels;
+
+    root = relink(order, 0, n, NIL, 0, redDepth);
+    count = n;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::relink(const vector<NodeIndex>& order, size_t lo, size_t hi, NodeIndex p, int depth, int redDepth) {
+    if (lo == hi) {
+        return NIL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    NodeIndex x = order[mid];
+    node(x).parentAndColor = p | (depth == redDepth ? RED_BIT : 0);
+    node(x).left = relink(order, lo, mid, x, depth + 1, redDepth);
+    node(x).right = relink(order, mid + 1, hi, x, depth + 1, redDepth);
+    node(x).size = static_cast<uint32_t>(hi - lo);
+    return x;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::build(vector<pair<K, V>> entries, bool sorted) {
+    clear();
+    if (!sorted) {
+        const Compare& keyLess = comp;
+        parallelSort(entries, [&keyLess](const pair<K, V>& a, const pair<K, V>& b) { return keyLess(a.first, b.first); });
+    }
+
+    vector<NodeIndex> order;
+    order.reserve(entries.size());
+    for (pair<K, V>& entry : entries) {
+        if (!order.empty() && !comp(key(order.back()), entry.first)) {
+            continue;
+        }
+        NodeIndex z = allocate();
+        allocator_traits<Alloc>::construct(alloc, &node(z).value(), piecewise_construct,
+                                           forward_as_tuple(move(entry.first)), forward_as_tuple(move(entry.second)));
+        order.push_back(z);
+    }
+    rebuild(order);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::unionWith(RedBlackTree&& other) {
+    if (&other == this || other.empty()) {
+        return;
+    }
+    if (other.size() * SMALL_MERGE_FACTOR < count) {
+        for (value_type& entry : other) {
+            tryEmplace(entry.first, move(entry.second));
+        }
+        other.clear();
+        return;
+    }
+
+    vector<NodeIndex> mine = inOrder();
+    vector<NodeIndex> order;
+    order.reserve(mine.size() + other.size());
+    size_t i = 0;
+    iterator it = other.begin();
+    while (i < mine.size() || it != other.end()) {
+        if (it == other.end() || (i < mine.size() && comp(key(mine[i]), it->first))) {
+            order.push_back(mine[i++]);
+        }
+        else if (i == mine.size() || comp(it->first, key(mine[i]))) {
+            NodeIndex z = allocate();
+            allocator_traits<Alloc>::construct(alloc, &node(z).value(), piecewise_construct,
+                                               forward_as_tuple(it->first), forward_as_tuple(move(it->second)));
+            order.push_back(z);
+            ++it;
+        }
+        else {
+            order.push_back(mine[i++]);
+            ++it;
+        }
+    }
+    other.clear();
+    rebuild(order);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::intersectWith(const RedBlackTree& other) {
+    if (&other == this) {
+        return;
+    }
+
+    vector<NodeIndex> order;
+    const_iterator it = other.begin();
+    for (NodeIndex x : inOrder()) {
+        while (it != other.end() && comp(it->first, key(x))) {
+            ++it;
+        }
+        if (it != other.end() && !comp(key(x), it->first)) {
+            order.push_back(x);
+        }
+        else {
+            destroyNode(x);
+        }
+    }
+    rebuild(order);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::subtract(const RedBlackTree& other) {
+    if (&other == this) {
+        clear();
+        return;
+    }
+    if (other.size() * SMALL_MERGE_FACTOR < count) {
+        for (const value_type& entry : other) {
+            erase(entry.first);
+        }
+        return;
+    }
+
+    vector<NodeIndex> order;
+    const_iterator it = other.begin();
+    for (NodeIndex x : inOrder()) {
+        while (it != other.end() && comp(it->first, key(x))) {
+            ++it;
+        }
+        if (it != other.end() && !comp(key(x), it->first)) {
+            destroyNode(x);
+        }
+        else {
+            order.push_back(x);
+        }
+    }
+    rebuild(order);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+template <typename KK>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::searchFor(NodeIndex x, const KK& target) const {
+    while (x != NIL) {
+        if (comp(target, key(x))) {
+            x = node(x).left;
+        }
+        else if (comp(key(x), target)) {
+            x = node(x).right;
+        }
+        else {
+            return x;
+        }
+    }
+    return x;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::searchBatch(const K* targets, size_t n, NodeIndex* results) const {
+    if (count < SEARCH_BATCH_MIN_SIZE) {
+        for (size_t i = 0; i < n; i++) {
+            results[i] = searchFor(root, targets[i]);
+        }
+        return;
+    }
+
+    // a lane is finished once its cursor reaches NIL; misses keep the NIL result they start with
+    NodeIndex cursor[SEARCH_BATCH_GROUP];
+    for (size_t start = 0; start < n; start += SEARCH_BATCH_GROUP) {
+        size_t group = std::min(SEARCH_BATCH_GROUP, n - start);
+        for (size_t i = 0; i < group; i++) {
+            cursor[i] = root;
+            results[start + i] = NIL;
+        }
+
+        size_t active = group;
+        while (active > 0) {
+            active = 0;
+            for (size_t i = 0; i < group; i++) {
+                NodeIndex x = cursor[i];
+                if (x == NIL) {
+                    continue;
+                }
+                const K& target = targets[start + i];
+                NodeIndex next;
+                if (comp(target, key(x))) {
+                    next = node(x).left;
+                }
+                else if (comp(key(x), target)) {
+                    next = node(x).right;
+                }
+                else {
+                    results[start + i] = x;
+                    cursor[i] = NIL;
+                    continue;
+                }
+                if (next != NIL) {
+                    __builtin_prefetch(&node(next));
+                    active++;
+                }
+                cursor[i] = next;
+            }
+        }
+    }
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::min(NodeIndex x) const {
+    while (node(x).left != NIL) {
+        x = node(x).left;
+    }
+    return x;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::max(NodeIndex x) const {
+    while (node(x).right != NIL) {
+        x = node(x).right;
+    }
+    return x;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::successor(NodeIndex x) const {
+    if (node(x).right != NIL) {
+        return min(node(x).right);
+    }
+    else {
+        NodeIndex y = parent(x);
+        while (y != NIL && (x == node(y).right)) {
+            x = y;
+            y = parent(y);
+        }
+        return y;
+    }
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::predecessor(NodeIndex x) const {
+    if (node(x).left != NIL) {
+        return max(node(x).left);
+    }
+    else {
+        NodeIndex y = parent(x);
+        while (y != NIL && (x == node(y).left)) {
+            x = y;
+            y = parent(y);
+        }
+        return y;
+    }
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::select(size_t k) const {
+    NodeIndex x = root;
+    while (x != NIL) {
+        size_t leftSize = node(node(x).left).size;
+        if (k < leftSize) {
+            x = node(x).left;
+        }
+        else if (k == leftSize) {
+            return x;
+        }
+        else {
+            k -= leftSize + 1;
+            x = node(x).right;
+        }
+    }
+    return NIL;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+size_t RedBlackTree<K, V, Compare, Alloc>::depth(NodeIndex x) const {
+    size_t links = 0;
+    while (x != root) {
+        x = parent(x);
+        links++;
+    }
+    return links;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+size_t RedBlackTree<K, V, Compare, Alloc>::rank(const K& target) const {
+    NodeIndex x = root;
+    size_t below = 0;
+    while (x != NIL) {
+        if (comp(key(x), target)) {
+            below += node(node(x).left).size + 1;
+            x = node(x).right;
+        }
+        else {
+            x = node(x).left;
+        }
+    }
+    return below;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+template <typename... Args>
+pair<NodeIndex, bool> RedBlackTree<K, V, Compare, Alloc>::emplace(Args&&... args) {
+    // the key only exists once the pair is built, so construct first and undo on a duplicate
+    NodeIndex z = allocate();
+    try {
+        allocator_traits<Alloc>::construct(alloc, &node(z).value(), forward<Args>(args)...);
+    }
+    catch (...) {
+        release(z);
+        throw;
+    }
+
+    NodeIndex x = root;
+    NodeIndex y = NIL;
+    bool goesLeft = false;
+    while (x != NIL) {
+        y = x;
+        if (comp(key(z), key(x))) {
+            goesLeft = true;
+            x = node(x).left;
+        }
+        else if (comp(key(x), key(z))) {
+            goesLeft = false;
+            x = node(x).right;
+        }
+        else {
+            allocator_traits<Alloc>::destroy(alloc, &node(z).value());
+            release(z);
+            return make_pair(x, false);
+        }
+    }
+
+    link(z, y, goesLeft);
+    return make_pair(z, true);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+template <typename KK, typename... Args>
+pair<NodeIndex, bool> RedBlackTree<K, V, Compare, Alloc>::tryEmplaceKey(KK&& k, Args&&... args) {
+    NodeIndex x = root;
+    NodeIndex y = NIL;
+    bool goesLeft = false;
+    while (x != NIL) {
+        y = x;
+        if (comp(k, key(x))) {
+            goesLeft = true;
+            x = node(x).left;
+        }
+        else if (comp(key(x), k)) {
+            goesLeft = false;
+            x = node(x).right;
+        }
+        else {
+            return make_pair(x, false);
+        }
+    }
+
+    // nothing is constructed, and the key is never copied, unless it is actually missing
+    NodeIndex z = allocate();
+    try {
+        allocator_traits<Alloc>::construct(alloc, &node(z).value(), piecewise_construct,
+                                           forward_as_tuple(forward<KK>(k)), forward_as_tuple(forward<Args>(args)...));
+    }
+    catch (...) {
+        release(z);
+        throw;
+    }
+    link(z, y, goesLeft);
+    return make_pair(z, true);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::link(NodeIndex z, NodeIndex y, bool goesLeft) {
+    setParent(z, y);
+    setRed(z);
+    node(z).size = 1;
+    for (NodeIndex p = y; p != NIL; p = parent(p)) {
+        node(p).size++;
+    }
+    if (y == NIL) {
+        root = z;
+    }
+    else if (goesLeft) {
+        left(y) = z;
+    }
+    else {
+        right(y) = z;
+    }
+    count++;
+    insertFixup(z);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::deleteNode(NodeIndex z) {
+    NodeIndex y = z;
+    bool yWasRed = isRed(y);
+    NodeIndex x;
+
+    if (left(z) == NIL) {
+        x = right(z);
+        transplant(z, right(z));
+    }
+    else if (right(z) == NIL) {
+        x = left(z);
+        transplant(z, left(z));
+    }
+    else {
+        y = min(right(z));
+        yWasRed = isRed(y);
+        x = right(y);
+        if (parent(y) == z) {
+            setParent(x, y);
+        }
+        else {
+            transplant(y, right(y));
+            right(y) = right(z);
+            setParent(right(y), y);
+        }
+        transplant(z, y);
+        left(y) = left(z);
+        setParent(left(y), y);
+        if (isRed(z)) {
+            setRed(y);
+        }
+        else {
+            setBlack(y);
+        }
+    }
+
+    // only the path above x's new position lost a node; rotations in the fixup keep their own sizes
+    for (NodeIndex p = parent(x); p != NIL; p = parent(p)) {
+        node(p).size = node(left(p)).size + node(right(p)).size + 1;
+    }
+
+    if (!yWasRed) {
+        deleteFixup(x);
+    }
+    allocator_traits<Alloc>::destroy(alloc, &node(z).value());
+    release(z);
+    count--;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+size_t RedBlackTree<K, V, Compare, Alloc>::erase(const K& k) {
+    NodeIndex x = find(k);
+    if (x == NIL) {
+        return 0;
+    }
+    deleteNode(x);
+    return 1;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::lowerBoundIndex(const K& target) const {
+    NodeIndex x = root;
+    NodeIndex found = NIL;
+    while (x != NIL) {
+        if (comp(key(x), target)) {
+            x = node(x).right;
+        }
+        else {
+            found = x;
+            x = node(x).left;
+        }
+    }
+    return found;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+NodeIndex RedBlackTree<K, V, Compare, Alloc>::upperBoundIndex(const K& target) const {
+    NodeIndex x = root;
+    NodeIndex found = NIL;
+    while (x != NIL) {
+        if (comp(target, key(x))) {
+            found = x;
+            x = node(x).left;
+        }
+        else {
+            x = node(x).right;
+        }
+    }
+    return found;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+typename RedBlackTree<K, V, Compare, Alloc>::template IteratorRange<typename RedBlackTree<K, V, Compare, Alloc>::iterator>
+RedBlackTree<K, V, Compare, Alloc>::range(const K& lo, const K& hi) {
+    // an empty or inverted interval must not start a walk that never meets its end
+    if (!comp(lo, hi)) {
+        return IteratorRange<iterator>(end(), end());
+    }
+    return IteratorRange<iterator>(lowerBound(lo), lowerBound(hi));
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+typename RedBlackTree<K, V, Compare, Alloc>::template IteratorRange<typename RedBlackTree<K, V, Compare, Alloc>::const_iterator>
+RedBlackTree<K, V, Compare, Alloc>::range(const K& lo, const K& hi) const {
+    if (!comp(lo, hi)) {
+        return IteratorRange<const_iterator>(end(), end());
+    }
+    return IteratorRange<const_iterator>(lowerBound(lo), lowerBound(hi));
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::inlineWalk(NodeIndex x) const {
+    if (x == NIL) {
+        return;
+    }
+    NodeIndex last = max(x);
+    for (NodeIndex y = min(x); ; y = successor(y)) {
+        cout << key(y) << "(" << (isRed(y) ? "red" : "black") << ") ";
+        if (y == last) {
+            break;
+        }
+    }
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::layeredWalk(NodeIndex x) const {
+    // Preorder without a stack: prev tells whether we just came down into y, or back
+    // up out of its left or right subtree.
+    if (x == NIL) {
+        return;
+    }
+    NodeIndex y = x;
+    NodeIndex prev = parent(x);
+    while (true) {
+        if (prev == parent(y)) {
+            cout << " " << key(y) << " ";
+            if (node(y).left != NIL) {
+                prev = y;
+                y = node(y).left;
+                continue;
+            }
+            prev = node(y).left;
+        }
+        if (prev == node(y).left && node(y).right != NIL) {
+            prev = y;
+            y = node(y).right;
+            continue;
+        }
+        cout << endl;
+        if (y == x) {
+            break;
+        }
+        prev = y;
+        y = parent(y);
+    }
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::leftRotate(NodeIndex x) {
+    NodeIndex y = right(x);
+    right(x) = left(y);
+    if (left(y) != NIL) {
+        setParent(left(y), x);
+    }
+    setParent(y, parent(x));
+    if (parent(x) == NIL) {
+        root = y;
+    }
+    else if (x == left(parent(x))) {
+        left(parent(x)) = y;
+    }
+    else {
+        right(parent(x)) = y;
+    }
+    left(y) = x;
+    setParent(x, y);
+    node(y).size = node(x).size;
+    node(x).size = node(left(x)).size + node(right(x)).size + 1;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::rightRotate(NodeIndex y) {
+    NodeIndex x = left(y);
+    left(y) = right(x);
+    if (right(x) != NIL) {
+        setParent(right(x), y);
+    }
+    setParent(x, parent(y));
+    if (parent(y) == NIL) {
+        root = x;
+    }
+    else if (y == right(parent(y))) {
+        right(parent(y)) = x;
+    }
+    else {
+        left(parent(y)) = x;
+    }
+    right(x) = y;
+    setParent(y, x);
+    node(x).size = node(y).size;
+    node(y).size = node(left(y)).size + node(right(y)).size + 1;
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::insertFixup(NodeIndex z) {
+    // the sentinel is black, so a missing uncle is handled like a black one
+    while (isRed(parent(z))) {
+        NodeIndex p = parent(z);
+        NodeIndex g = parent(p);
+        if (p == left(g)) {
+            NodeIndex y = right(g);
+            if (isRed(y)) {
+                setBlack(p);
+                setBlack(y);
+                setRed(g);
+                z = g;
+            }
+            else {
+                if (z == right(p)) {
+                    z = p;
+                    leftRotate(z);
+                }
+                setBlack(parent(z));
+                setRed(parent(parent(z)));
+                rightRotate(parent(parent(z)));
+            }
+        }
+        else {
+            NodeIndex y = left(g);
+            if (isRed(y)) {
+                setBlack(p);
+                setBlack(y);
+                setRed(g);
+                z = g;
+            }
+            else {
+                if (z == left(p)) {
+                    z = p;
+                    rightRotate(z);
+                }
+                setBlack(parent(z));
+                setRed(parent(parent(z)));
+                leftRotate(parent(parent(z)));
+            }
+        }
+    }
+    setBlack(root);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::deleteFixup(NodeIndex x) {
+    while (x != root && !isRed(x)) {
+        if (x == left(parent(x))) {
+            NodeIndex w = right(parent(x));
+            if (isRed(w)) {
+                setBlack(w);
+                setRed(parent(x));
+                leftRotate(parent(x));
+                w = right(parent(x));
+            }
+            if (!isRed(left(w)) && !isRed(right(w))) {
+                setRed(w);
+                x = parent(x);
+            }
+            else {
+                if (!isRed(right(w))) {
+                    setBlack(left(w));
+                    setRed(w);
+                    rightRotate(w);
+                    w = right(parent(x));
+                }
+                if (isRed(parent(x))) {
+                    setRed(w);
+                }
+                else {
+                    setBlack(w);
+                }
+                setBlack(parent(x));
+                setBlack(right(w));
+                leftRotate(parent(x));
+                x = root;
+            }
+        }
+        else {
+            NodeIndex w = left(parent(x));
+            if (isRed(w)) {
+                setBlack(w);
+                setRed(parent(x));
+                rightRotate(parent(x));
+                w = left(parent(x));
+            }
+            if (!isRed(right(w)) && !isRed(left(w))) {
+                setRed(w);
+                x = parent(x);
+            }
+            else {
+                if (!isRed(left(w))) {
+                    setBlack(right(w));
+                    setRed(w);
+                    leftRotate(w);
+                    w = left(parent(x));
+                }
+                if (isRed(parent(x))) {
+                    setRed(w);
+                }
+                else {
+                    setBlack(w);
+                }
+                setBlack(parent(x));
+                setBlack(left(w));
+                rightRotate(parent(x));
+                x = root;
+            }
+        }
+    }
+    setBlack(x);
+}
+
+template <typename K, typename V, typename Compare, typename Alloc>
+void RedBlackTree<K, V, Compare, Alloc>::transplant(NodeIndex u, NodeIndex v) {
+    if (parent(u) == NIL) {
+        root = v;
+    }
+    else if (u == left(parent(u))) {
+        left(parent(u)) = v;
+    }
+    else {
+        right(parent(u)) = v;
+    }
+    // v may be the sentinel; deleteFixup relies on its parent being set here
+    setParent(v, parent(u));
+}
+
+// Readers announce themselves on one of these striped counters so that they do not all
+// contend on a single cache line. A thread keeps the stripe it is first given.
+const int READ_STRIPES = 64;
+
+struct alignas(64) ReadStripe {
+    atomic<long> readers;
+};
+
+atomic<unsigned> nextReadStripe(0);
+
+unsigned readStripe() {
+    thread_local unsigned stripe = nextReadStripe.fetch_add(1) % READ_STRIPES;
+    return stripe;
+}
+
+class ReadIndicator {
+    public:
+        ReadIndicator() {
+            for (ReadStripe& s : stripes) {
+                s.readers.store(0);
+            }
+        }
+
+        void arrive(unsigned stripe) { stripes[stripe].readers.fetch_add(1); }
+        void depart(unsigned stripe) { stripes[stripe].readers.fetch_sub(1); }
+
+        bool isEmpty() const {
+            for (const ReadStripe& s : stripes) {
+                if (s.readers.load() != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        ReadStripe stripes[READ_STRIPES];
+};
+
+// A RedBlackTree that many threads can read while one writer at a time updates it, using
+// the Left-Right technique. Two copies of the tree are kept: readers use whichever copy is
+// active, never taking a lock or retrying, while the writer updates the idle copy, swaps
+// the roles, waits for readers still on the old copy to leave, and then repeats the update
+// there. Writes therefore run twice and must be deterministic, and V must be copyable.
+template <typename K, typename V, typename Compare = less<K>>
+class ConcurrentRedBlackTree {
+    public:
+        typedef RedBlackTree<K, V, Compare> Tree;
+
+        ConcurrentRedBlackTree() : active(0), versionIndex(0) {}
+
+        // runs reader on the current tree; it must not hold on to anything inside it
+        template <typename Reader>
+        auto read(Reader reader) const -> decltype(reader(declval<const Tree&>()));
+        // applies writer to both copies in turn
+        template <typename Writer>
+        void write(Writer writer);
+
+        bool search(const K& key, V& result) const;
+        // the smallest key greater than key
+        bool successor(const K& key, K& result) const;
+        // calls visit(key, value) for every entry with lo <= key < hi
+        template <typename Visitor>
+        void range(const K& lo, const K& hi, Visitor visit) const;
+        size_t size() const;
+
+        void insert(const K& key, const V& value);
+        bool erase(const K& key);
+
+    private:
+        Tree trees[2];
+        atomic<int> active;
+        atomic<int> versionIndex;
+        mutable ReadIndicator indicators[2];
+        mutex writerLock;
+};
+
+template <typename K, typename V, typename Compare>
+template <typename Reader>
+auto ConcurrentRedBlackTree<K, V, Compare>::read(Reader reader) const -> decltype(reader(declval<const Tree&>())) {
+    unsigned stripe = readStripe();
+    int version = versionIndex.load();
+    indicators[version].arrive(stripe);
+
+    // departs even if the reader throws
+    struct Departure {
+        ReadIndicator& indicator;
+        unsigned stripe;
+        ~Departure() { indicator.depart(stripe); }
+    } departure{indicators[version], stripe};
+
+    return reader(static_cast<const Tree&>(trees[active.load()]));
+}
+
+template <typename K, typename V, typename Compare>
+template <typename Writer>
+void ConcurrentRedBlackTree<K, V, Compare>::write(Writer writer) {
+    lock_guard<mutex> lock(writerLock);
+    int current = active.load();
+    writer(trees[1 - current]);
+    active.store(1 - current);
+
+    // New readers may still have arrived on the old version's indicator before seeing the
+    // switch, so drain the next indicator, flip readers onto it, then drain the previous one.
+    int previous = versionIndex.load();
+    int next = 1 - previous;
+    while (!indicators[next].isEmpty()) {
+        this_thread::yield();
+    }
+    versionIndex.store(next);
+    while (!indicators[previous].isEmpty()) {
+        this_thread::yield();
+    }
+
+    writer(trees[current]);
+}
+
+template <typename K, typename V, typename Compare>
+bool ConcurrentRedBlackTree<K, V, Compare>::search(const K& key, V& result) const {
+    return read([&](const Tree& tree) {
+        NodeIndex x = tree.find(key);
+        if (x == NIL) {
+            return false;
+        }
+        result = tree.value(x);
+        return true;
+    });
+}
 
-        Node(int k, string color) : key(k), color(color), parent(nullptr), left(nullptr), right(nullptr) {}
-};
+template <typename K, typename V, typename Compare>
+bool ConcurrentRedBlackTree<K, V, Compare>::successor(const K& key, K& result) const {
+    return read([&](const Tree& tree) {
+        typename Tree::const_iterator it = tree.upperBound(key);
+        if (it == tree.end()) {
+            return false;
+        }
+        result = it->first;
+        return true;
+    });
+}
 
-class RedBlackTree {
+template <typename K, typename V, typename Compare>
+template <typename Visitor>
+void ConcurrentRedBlackTree<K, V, Compare>::range(const K& lo, const K& hi, Visitor visit) const {
+    read([&](const Tree& tree) {
+        for (const auto& entry : tree.range(lo, hi)) {
+            visit(entry.first, entry.second);
+        }
+    });
+}
+
+template <typename K, typename V, typename Compare>
+size_t ConcurrentRedBlackTree<K, V, Compare>::size() const {
+    return read([](const Tree& tree) { return tree.size(); });
+}
+
+template <typename K, typename V, typename Compare>
+void ConcurrentRedBlackTree<K, V, Compare>::insert(const K& key, const V& value) {
+    write([&](Tree& tree) { tree[key] = value; });
+}
+
+template <typename K, typename V, typename Compare>
+bool ConcurrentRedBlackTree<K, V, Compare>::erase(const K& key) {
+    bool erased = false;
+    write([&](Tree& tree) { erased = tree.erase(key) > 0; });
+    return erased;
+}
+
+// An immutable red-black tree. Writes copy only the nodes on the path they touch and share
+// everything else, so a snapshot is just another handle on the same root. Nodes are freed by
+// reference counting once no snapshot reaches them, and since they never change a snapshot
+// can be read from any thread. There are no parent links, which is what makes sharing
+// possible; insert follows Okasaki's balance and delete follows Kahrs.
+template <typename K, typename V, typename Compare = less<K>>
+class PersistentRedBlackTree {
     public:
-        Node* root;
-
-        RedBlackTree() : root(nullptr) {}
-
-        Node* search(Node* x, int target);
-        Node* min(Node* x);
-        Node* max(Node* x);
-        Node* successor(Node* x);
-        Node* predecessor(Node* x);
-        void insert(int key);
-        void deleteNode(Node* target);
-        void inlineWalk(Node* x);
-        void layeredWalk(Node* x);
-    
+        PersistentRedBlackTree(const Compare& comp = Compare()) : comp(comp), count(0) {}
+
+        // O(1): later writes to either tree copy their own paths and leave the other alone
+        PersistentRedBlackTree snapshot() const { return *this; }
+
+        // the value stored for key, or nullptr; valid while any snapshot holding it lives
+        const V* search(const K& key) const;
+        void insert(const K& key, const V& value);
+        bool erase(const K& key);
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        // calls visit(key, value) in key order, for every entry or for lo <= key < hi
+        template <typename Visitor>
+        void forEach(Visitor visit) const;
+        template <typename Visitor>
+        void range(const K& lo, const K& hi, Visitor visit) const;
+
     private:
-        void leftRotate(Node* x);
-        void rightRotate(Node* y);
-        void insertFixup(Node* z);
-        void transplant(Node* u, Node* v);
+        class PersistentNode;
+        typedef shared_ptr<const PersistentNode> Link;
+        typedef pair<K, V> Entry;
+
+        class PersistentNode {
+            public:
+                bool red;
+                Link left;
+                Link right;
+                Entry entry;
+
+                PersistentNode(bool red, Link left, const Entry& entry, Link right)
+                    : red(red), left(move(left)), right(move(right)), entry(entry) {}
+        };
+
+        Compare comp;
+        Link root;
+        size_t count;
+
+        static Link makeNode(bool red, Link left, const Entry& entry, Link right) {
+            return make_shared<const PersistentNode>(red, move(left), entry, move(right));
+        }
+        static bool isRed(const Link& t) { return t && t->red; }
+        static bool isBlack(const Link& t) { return t && !t->red; }
+        static Link blacken(const Link& t) { return isRed(t) ? makeNode(false, t->left, t->entry, t->right) : t; }
+
+        static Link balance(const Link& l, const Entry& e, const Link& r);
+        static Link balanceLeft(const Link& l, const Entry& e, const Link& r);
+        static Link balanceRight(const Link& l, const Entry& e, const Link& r);
+        static Link redden(const Link& t);
+        static Link append(const Link& l, const Link& r);
+        Link insertBelow(const Link& t, const Entry& fresh) const;
+        Link eraseBelow(const Link& t, const K& key) const;
 };
 
-Node* RedBlackTree::search(Node* x, int target) {
-    while (x && (target != x->key)) {
-        if (target < x->key) {
-            x = x->left;
+template <typename K, typename V, typename Compare>
+const V* PersistentRedBlackTree<K, V, Compare>::search(const K& key) const {
+    const PersistentNode* x = root.get();
+    while (x) {
+        if (comp(key, x->entry.first)) {
+            x = x->left.get();
+        }
+        else if (comp(x->entry.first, key)) {
+            x = x->right.get();
+        }
+        else {
+            return &x->entry.second;
         }
-            x = x->right;
     }
-    return x;
+    return nullptr;
 }
 
-Node* RedBlackTree::min(Node* x) {
-    while (x->left) {
-        x = x->left;
+template <typename K, typename V, typename Compare>
+void PersistentRedBlackTree<K, V, Compare>::insert(const K& key, const V& value) {
+    if (!search(key)) {
+        count++;
     }
-    return x;
+    root = blacken(insertBelow(root, Entry(key, value)));
 }
 
-Node* RedBlackTree::max(Node* x) {
-    while (x->right) {
-        x = x->right;
+template <typename K, typename V, typename Compare>
+bool PersistentRedBlackTree<K, V, Compare>::erase(const K& key) {
+    // the rebalancing below assumes the key is present, and a miss should copy nothing
+    if (!search(key)) {
+        return false;
     }
-    return x;
+    root = blacken(eraseBelow(root, key));
+    count--;
+    return true;
 }
 
-Node* RedBlackTree::successor(Node* x) {
-    if (x->right) {
-        return min(x->right);
+template <typename K, typename V, typename Compare>
+template <typename Visitor>
+void PersistentRedBlackTree<K, V, Compare>::forEach(Visitor visit) const {
+    vector<const PersistentNode*> path;
+    const PersistentNode* x = root.get();
+    while (x || !path.empty()) {
+        while (x) {
+            path.push_back(x);
+            x = x->left.get();
+        }
+        x = path.back();
+        path.pop_back();
+        visit(x->entry.first, x->entry.second);
+        x = x->right.get();
     }
-    else {
-        Node* y = x->parent;
-        while (y && (x == y->right)) {
-            x = y;
-            y = y->parent;
+}
+
+template <typename K, typename V, typename Compare>
+template <typename Visitor>
+void PersistentRedBlackTree<K, V, Compare>::range(const K& lo, const K& hi, Visitor visit) const {
+    // descend only into subtrees that can hold keys at or above lo, and stop at hi
+    vector<const PersistentNode*> path;
+    const PersistentNode* x = root.get();
+    while (x || !path.empty()) {
+        while (x) {
+            if (comp(x->entry.first, lo)) {
+                x = x->right.get();
+            }
+            else {
+                path.push_back(x);
+                x = x->left.get();
+            }
         }
-        return y;
+        if (path.empty()) {
+            break;
+        }
+        x = path.back();
+        path.pop_back();
+        if (!comp(x->entry.first, hi)) {
+            break;
+        }
+        visit(x->entry.first, x->entry.second);
+        x = x->right.get();
     }
 }
 
-Node* RedBlackTree::predecessor(Node* x) {
-    if (x->left) {
-        return max(x->left);
+template <typename K, typename V, typename Compare>
+typename PersistentRedBlackTree<K, V, Compare>::Link
+PersistentRedBlackTree<K, V, Compare>::balance(const Link& l, const Entry& e, const Link& r) {
+    // the four red-red shapes (plus two red children) all become a red node over two black ones
+    if (isRed(l) && isRed(r)) {
+        return makeNode(true, makeNode(false, l->left, l->entry, l->right), e, makeNode(false, r->left, r->entry, r->right));
     }
-    else {
-        Node* y = x->parent;
-        while (y && (x == y->left)) {
-            x = y;
-            y = y->parent;
-        }
-        return y;
+    if (isRed(l) && isRed(l->left)) {
+        return makeNode(true, makeNode(false, l->left->left, l->left->entry, l->left->right), l->entry, makeNode(false, l->right, e, r));
+    }
+    if (isRed(l) && isRed(l->right)) {
+        return makeNode(true, makeNode(false, l->left, l->entry, l->right->left), l->right->entry, makeNode(false, l->right->right, e, r));
+    }
+    if (isRed(r) && isRed(r->right)) {
+        return makeNode(true, makeNode(false, l, e, r->left), r->entry, makeNode(false, r->right->left, r->right->entry, r->right->right));
+    }
+    if (isRed(r) && isRed(r->left)) {
+        return makeNode(true, makeNode(false, l, e, r->left->left), r->left->entry, makeNode(false, r->left->right, r->entry, r->right));
     }
+    return makeNode(false, l, e, r);
 }
 
-void RedBlackTree::insert(int key) {
-    Node* x = root;
-    Node* y = nullptr;
-    Node* z = new Node(key, RED);
-    while (x) {
-        y = x;
-        if (z->key < x->key) {
-            x = x->left;
+// Rebuilds a node whose left side lost one black level
+template <typename K, typename V, typename Compare>
+typename PersistentRedBlackTree<K, V, Compare>::Link
+PersistentRedBlackTree<K, V, Compare>::balanceLeft(const Link& l, const Entry& e, const Link& r) {
+    if (isRed(l)) {
+        return makeNode(true, makeNode(false, l->left, l->entry, l->right), e, r);
+    }
+    if (isBlack(r)) {
+        return balance(l, e, makeNode(true, r->left, r->entry, r->right));
+    }
+    return makeNode(true, makeNode(false, l, e, r->left->left), r->left->entry, balance(r->left->right, r->entry, redden(r->right)));
+}
+
+// Rebuilds a node whose right side lost one black level
+template <typename K, typename V, typename Compare>
+typename PersistentRedBlackTree<K, V, Compare>::Link
+PersistentRedBlackTree<K, V, Compare>::balanceRight(const Link& l, const Entry& e, const Link& r) {
+    if (isRed(r)) {
+        return makeNode(true, l, e, makeNode(false, r->left, r->entry, r->right));
+    }
+    if (isBlack(l)) {
+        return balance(makeNode(true, l->left, l->entry, l->right), e, r);
+    }
+    return makeNode(true, balance(redden(l->left), l->entry, l->right->left), l->right->entry, makeNode(false, l->right->right, e, r));
+}
+
+template <typename K, typename V, typename Compare>
+typename PersistentRedBlackTree<K, V, Compare>::Link
+PersistentRedBlackTree<K, V, Compare>::redden(const Link& t) {
+    return makeNode(true, t->left, t->entry, t->right);
+}
+
+// Joins two subtrees of equal black height whose keys are all ordered l < r
+template <typename K, typename V, typename Compare>
+typename PersistentRedBlackTree<K, V, Compare>::Link
+PersistentRedBlackTree<K, V, Compare>::append(const Link& l, const Link& r) {
+    if (!l) {
+        return r;
+    }
+    if (!r) {
+        return l;
+    }
+    if (l->red && r->red) {
+        Link middle = append(l->right, r->left);
+        if (isRed(middle)) {
+            return makeNode(true, makeNode(true, l->left, l->entry, middle->left), middle->entry, makeNode(true, middle->right, r->entry, r->right));
         }
-        else {
-            x = x->right;
+        return makeNode(true, l->left, l->entry, makeNode(true, middle, r->entry, r->right));
+    }
+    if (!l->red && !r->red) {
+        Link middle = append(l->right, r->left);
+        if (isRed(middle)) {
+            return makeNode(true, makeNode(false, l->left, l->entry, middle->left), middle->entry, makeNode(false, middle->right, r->entry, r->right));
         }
+        return balanceLeft(l->left, l->entry, makeNode(false, middle, r->entry, r->right));
     }
-    z->parent = y;
-    if (!y) {
-        root = z;
-        root->color = BLACK;
-        return;
+    if (r->red) {
+        return makeNode(true, append(l, r->left), r->entry, r->right);
+    }
+    return makeNode(true, l->left, l->entry, append(l->right, r));
+}
+
+template <typename K, typename V, typename Compare>
+typename PersistentRedBlackTree<K, V, Compare>::Link
+PersistentRedBlackTree<K, V, Compare>::insertBelow(const Link& t, const Entry& fresh) const {
+    if (!t) {
+        return makeNode(true, nullptr, fresh, nullptr);
     }
-    else if (z->key < y->key) {
-        y->left = z;
+    if (comp(fresh.first, t->entry.first)) {
+        Link left = insertBelow(t->left, fresh);
+        return t->red ? makeNode(true, left, t->entry, t->right) : balance(left, t->entry, t->right);
     }
-    else {
-        y->right = z;
+    if (comp(t->entry.first, fresh.first)) {
+        Link right = insertBelow(t->right, fresh);
+        return t->red ? makeNode(true, t->left, t->entry, right) : balance(t->left, t->entry, right);
     }
-    insertFixup(z);
+    return makeNode(t->red, t->left, fresh, t->right);
 }
 
-void RedBlackTree::deleteNode(Node* z) {
-    if (!z->left) {
-        transplant(z, z->right);
+template <typename K, typename V, typename Compare>
+typename PersistentRedBlackTree<K, V, Compare>::Link
+PersistentRedBlackTree<K, V, Compare>::eraseBelow(const Link& t, const K& key) const {
+    // Erasing below a black child shortens that side, which balanceLeft/Right repair; below
+    // a red child (or the sentinel) the heights stay put and the node just turns red.
+    if (comp(key, t->entry.first)) {
+        Link left = eraseBelow(t->left, key);
+        return isBlack(t->left) ? balanceLeft(left, t->entry, t->right) : makeNode(true, left, t->entry, t->right);
     }
-    else if (!z->right) {
-        transplant(z, z->left);
+    if (comp(t->entry.first, key)) {
+        Link right = eraseBelow(t->right, key);
+        return isBlack(t->right) ? balanceRight(t->left, t->entry, right) : makeNode(true, t->left, t->entry, right);
     }
-    else {
-        Node* y = min(z->right);
-        if (y != z->right) {
-            transplant(y, y->right);
-            y->right = z->right;
-            y->right->parent = y;
+    return append(t->left, t->right);
+}
+
+// Read-only queries on a file written by RedBlackTree::save, answered straight from a
+// memory mapping. Opening only checks the header, and nothing is read, copied or allocated
+// beyond it, so startup takes the same time whatever the size of the tree. Walks ignore any
+// link that does not lead further along the breadth-first numbering, and range visits at most
+// size() entries, so even a corrupt file is never read out of bounds and never makes a query
+// loop. verify() checks the whole file when its answers must be trusted.
+template <typename K, typename V, typename Compare = less<K>>
+class RedBlackTreeView {
+    public:
+        RedBlackTreeView(const string& path, const Compare& comp = Compare());
+
+        // false when the file is missing, its header is corrupt, or it was not written for
+        // these key and value types
+        bool isOpen() const { return nodes != nullptr; }
+        size_t size() const { return count; }
+        // reads every node, checking the links, subtree sizes, red-black rules and key order
+        bool verify() const;
+
+        NodeIndex find(const K& target) const;
+        NodeIndex lowerBound(const K& target) const;
+        NodeIndex min() const;
+        NodeIndex successor(NodeIndex x) const;
+        // calls visit(key, value) for every entry with lo <= key < hi
+        template <typename Visitor>
+        void range(const K& lo, const K& hi, Visitor visit) const;
+
+        const K& key(NodeIndex x) const { return nodes[x].value().first; }
+        const V& value(NodeIndex x) const { return nodes[x].value().second; }
+
+    private:
+        typedef Node<pair<const K, V>> TreeNode;
+
+        MappedFile file;
+        Compare comp;
+        TreeNode* nodes;
+        NodeIndex root;
+        size_t count;
+
+        NodeIndex left(NodeIndex x) const { NodeIndex y = nodes[x].left; return (y > x && y <= count) ? y : NIL; }
+        NodeIndex right(NodeIndex x) const { NodeIndex y = nodes[x].right; return (y > x && y <= count) ? y : NIL; }
+        NodeIndex parent(NodeIndex x) const { NodeIndex y = nodes[x].parentAndColor & PARENT_MASK; return (y < x) ? y : NIL; }
+};
+
+template <typename K, typename V, typename Compare>
+RedBlackTreeView<K, V, Compare>::RedBlackTreeView(const string& path, const Compare& comp)
+    : file(path), comp(comp), nodes(nullptr), root(NIL), count(0) {
+    static_assert(is_trivially_copyable<K>::value && is_trivially_copyable<V>::value, "views need trivially copyable keys and values");
+    // the mapping is read-only; value() only ever hands out const references into it
+    nodes = const_cast<TreeNode*>(treeFileNodes<TreeNode, K, V>(file, root, count));
+}
+
+template <typename K, typename V, typename Compare>
+bool RedBlackTreeView<K, V, Compare>::verify() const {
+    return isOpen() && treeFileLinksValid(nodes, count) && treeFileKeysOrdered(nodes, count, comp);
+}
+
+template <typename K, typename V, typename Compare>
+NodeIndex RedBlackTreeView<K, V, Compare>::find(const K& target) const {
+    NodeIndex x = isOpen() ? root : NIL;
+    while (x != NIL) {
+        if (comp(target, key(x))) {
+            x = left(x);
         }
-        transplant(z, y);
-        y->left = z->left;
-        y->left->parent = y;
-    }  
+        else if (comp(key(x), target)) {
+            x = right(x);
+        }
+        else {
+            return x;
+        }
+    }
+    return NIL;
 }
 
-void RedBlackTree::inlineWalk(Node* x) {
-    if (x) {
-        inlineWalk(x->left);
-        cout << x->key << "(" << x->color << ") ";
-        inlineWalk(x->right);
+template <typename K, typename V, typename Compare>
+NodeIndex RedBlackTreeView<K, V, Compare>::lowerBound(const K& target) const {
+    NodeIndex x = isOpen() ? root : NIL;
+    NodeIndex found = NIL;
+    while (x != NIL) {
+        if (comp(key(x), target)) {
+            x = right(x);
+        }
+        else {
+            found = x;
+            x = left(x);
+        }
     }
+    return found;
 }
 
-void RedBlackTree::layeredWalk(Node* x) {
-    if (x) {
-        cout << " " << x->key << " ";
-        layeredWalk(x->left);
-        layeredWalk(x->right);
-        cout << endl;
+template <typename K, typename V, typename Compare>
+NodeIndex RedBlackTreeView<K, V, Compare>::min() const {
+    NodeIndex x = isOpen() ? root : NIL;
+    while (x != NIL && left(x) != NIL) {
+        x = left(x);
     }
+    return x;
 }
 
-void RedBlackTree::leftRotate(Node* x) {
-    Node* y = x->right;
-    x->right = y->left;
-    if (y->left) {
-        y->left->parent = x;
+template <typename K, typename V, typename Compare>
+NodeIndex RedBlackTreeView<K, V, Compare>::successor(NodeIndex x) const {
+    if (right(x) != NIL) {
+        x = right(x);
+        while (left(x) != NIL) {
+            x = left(x);
+        }
+        return x;
     }
-    y->parent = x->parent;
-    if (!x->parent) {
-        root = y;
+    NodeIndex y = parent(x);
+    while (y != NIL && x == right(y)) {
+        x = y;
+        y = parent(y);
     }
-    else if (x == x->parent->left) {
-        x->parent->left = y;
+    return y;
+}
+
+template <typename K, typename V, typename Compare>
+template <typename Visitor>
+void RedBlackTreeView<K, V, Compare>::range(const K& lo, const K& hi, Visitor visit) const {
+    // a corrupt file can chain successors into a cycle, and no tree has more than count entries
+    size_t visited = 0;
+    for (NodeIndex x = lowerBound(lo); x != NIL && visited < count && comp(key(x), hi); x = successor(x), visited++) {
+        visit(key(x), value(x));
     }
-    else {
-        x->parent->right = y;
+}
+
+// Keys per B+ tree node. 32 ints fill two cache lines, and a search reads a whole node
+// with a handful of vector compares instead of a chain of dependent loads.
+const int BTREE_NODE_KEYS = 32;
+const int BTREE_MIN_KEYS = BTREE_NODE_KEYS / 2;
+
+// How many of a node's sorted keys come before target, or with orEqual, do not come after
+// it. That is the slot to search in a leaf, or the child to descend into.
+template <typename K, typename Compare>
+int countBefore(const K* keys, int count, const K& target, const Compare& comp, bool orEqual) {
+    if (orEqual) {
+        return static_cast<int>(upper_bound(keys, keys + count, target, comp) - keys);
     }
-    y->left = x;
-    x->parent = y;
+    return static_cast<int>(lower_bound(keys, keys + count, target, comp) - keys);
 }
 
-void RedBlackTree::rightRotate(Node* y) {
-    Node* x = y->left;
-    y->left = x->right;
-    if (x->right) {
-        x->right->parent = y;
+#ifdef BPLUS_TREE_SSE2
+// For int keys compare four at a time and count the matching lanes. This is a branch-free
+// linear scan of the node, with no mispredicted binary search steps.
+int countBefore(const int* keys, int count, const int& target, const less<int>&, bool orEqual) {
+    const __m128i wanted = _mm_set1_epi32(target);
+    int before = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        // keys before target are those below it, or with orEqual those not above it
+        __m128i mask = orEqual ? _mm_cmpgt_epi32(lanes, wanted) : _mm_cmplt_epi32(lanes, wanted);
+        int bits = __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+        before += orEqual ? 4 - bits : bits;
     }
-    x->parent = y->parent;
-    if (!y->parent) {
-        root = x;
+    for (; i < count; i++) {
+        before += orEqual ? (keys[i] <= target) : (keys[i] < target);
+    }
+    return before;
+}
+#endif
+
+// An ordered map with the same find/insert/erase/bound/iterator API as RedBlackTree, kept in
+// a B+ tree: wide nodes make the tree a few levels deep, so a search touches a handful of
+// nodes rather than log2(n). Entries live in the leaves, which are chained in key order for
+// scans. K and V must be default constructible, since nodes hold fixed arrays of them.
+template <typename K, typename V, typename Compare = less<K>>
+class BPlusTree {
+    private:
+        class BTreeNode {
+            public:
+                bool isLeaf;
+                int count;
+                K keys[BTREE_NODE_KEYS];
+
+                BTreeNode(bool isLeaf) : isLeaf(isLeaf), count(0) {}
+        };
+
+        // children[i] holds keys before keys[i]; children[i + 1] holds the rest
+        class BTreeInner : public BTreeNode {
+            public:
+                BTreeNode* children[BTREE_NODE_KEYS + 1];
+
+                BTreeInner() : BTreeNode(false) {}
+        };
+
+        class BTreeLeaf : public BTreeNode {
+            public:
+                V values[BTREE_NODE_KEYS];
+                BTreeLeaf* prev;
+                BTreeLeaf* next;
+
+                BTreeLeaf() : BTreeNode(true), prev(nullptr), next(nullptr) {}
+        };
+
+    public:
+        // Walks the leaf chain; key() and value() stand in for a pair, since a leaf keeps its
+        // keys and values in separate arrays. end() has no leaf, and stepping back from it
+        // lands on the largest key.
+        class iterator {
+            public:
+                iterator() : tree(nullptr), leaf(nullptr), slot(0) {}
+                iterator(const BPlusTree* tree, BTreeLeaf* leaf, int slot) : tree(tree), leaf(leaf), slot(slot) {}
+
+                const K& key() const { return leaf->keys[slot]; }
+                V& value() const { return leaf->values[slot]; }
+                iterator& operator++();
+                iterator& operator--();
+                bool operator==(const iterator& other) const { return leaf == other.leaf && slot == other.slot; }
+                bool operator!=(const iterator& other) const { return !(*this == other); }
+
+            private:
+                const BPlusTree* tree;
+                BTreeLeaf* leaf;
+                int slot;
+        };
+
+        BPlusTree(const Compare& comp = Compare());
+        BPlusTree(const BPlusTree&) = delete;
+        BPlusTree& operator=(const BPlusTree&) = delete;
+        ~BPlusTree();
+
+        iterator find(const K& key) const;
+        iterator lowerBound(const K& key) const;
+        iterator upperBound(const K& key) const;
+        // the smallest key greater than key, as in ConcurrentRedBlackTree
+        bool successor(const K& key, K& result) const;
+        iterator begin() const { return count == 0 ? end() : iterator(this, first, 0); }
+        iterator end() const { return iterator(this, nullptr, 0); }
+
+        // like RedBlackTree::insert, an existing key keeps its value
+        pair<iterator, bool> insert(const K& key, const V& value);
+        size_t erase(const K& key);
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        // number of levels, which is the number of nodes every search reads
+        int height() const;
+
+    private:
+        Compare comp;
+        BTreeNode* root;
+        BTreeLeaf* first;
+        BTreeLeaf* last;
+        size_t count;
+
+        BTreeLeaf* leafFor(const K& key) const;
+        BTreeNode* insertBelow(BTreeNode* x, const K& key, const V& value, iterator& where, bool& inserted, K& separator);
+        bool eraseBelow(BTreeNode* x, const K& key, bool& erased);
+        void fixChild(BTreeInner* parent, int i);
+        void mergeChildren(BTreeInner* parent, int i);
+        void destroy(BTreeNode* x);
+};
+
+template <typename K, typename V, typename Compare>
+typename BPlusTree<K, V, Compare>::iterator& BPlusTree<K, V, Compare>::iterator::operator++() {
+    if (++slot == leaf->count) {
+        leaf = leaf->next;
+        slot = 0;
     }
-    else if (y == y->parent->right) {
-        y->parent->right = x;
+    return *this;
+}
+
+template <typename K, typename V, typename Compare>
+typename BPlusTree<K, V, Compare>::iterator& BPlusTree<K, V, Compare>::iterator::operator--() {
+    if (!leaf) {
+        leaf = tree->last;
+        slot = leaf->count - 1;
+    }
+    else if (slot == 0) {
+        leaf = leaf->prev;
+        slot = leaf->count - 1;
     }
     else {
-        y->parent->left = x;
+        slot--;
+    }
+    return *this;
+}
+
+template <typename K, typename V, typename Compare>
+BPlusTree<K, V, Compare>::BPlusTree(const Compare& comp) : comp(comp), count(0) {
+    first = last = new BTreeLeaf();
+    root = first;
+}
+
+template <typename K, typename V, typename Compare>
+BPlusTree<K, V, Compare>::~BPlusTree() {
+    destroy(root);
+}
+
+template <typename K, typename V, typename Compare>
+void BPlusTree<K, V, Compare>::destroy(BTreeNode* x) {
+    if (x->isLeaf) {
+        delete static_cast<BTreeLeaf*>(x);
+        return;
+    }
+    BTreeInner* inner = static_cast<BTreeInner*>(x);
+    for (int i = 0; i <= inner->count; i++) {
+        destroy(inner->children[i]);
+    }
+    delete inner;
+}
+
+template <typename K, typename V, typename Compare>
+int BPlusTree<K, V, Compare>::height() const {
+    int levels = 1;
+    for (BTreeNode* x = root; !x->isLeaf; x = static_cast<BTreeInner*>(x)->children[0]) {
+        levels++;
+    }
+    return levels;
+}
+
+template <typename K, typename V, typename Compare>
+typename BPlusTree<K, V, Compare>::BTreeLeaf* BPlusTree<K, V, Compare>::leafFor(const K& key) const {
+    BTreeNode* x = root;
+    while (!x->isLeaf) {
+        BTreeInner* inner = static_cast<BTreeInner*>(x);
+        x = inner->children[countBefore(inner->keys, inner->count, key, comp, true)];
+    }
+    return static_cast<BTreeLeaf*>(x);
+}
+
+template <typename K, typename V, typename Compare>
+typename BPlusTree<K, V, Compare>::iterator BPlusTree<K, V, Compare>::lowerBound(const K& key) const {
+    BTreeLeaf* leaf = leafFor(key);
+    int slot = countBefore(leaf->keys, leaf->count, key, comp, false);
+    // separators can outlive their keys, so the bound may sit at the start of the next leaf
+    if (slot == leaf->count) {
+        return leaf->next ? iterator(this, leaf->next, 0) : end();
+    }
+    return iterator(this, leaf, slot);
+}
+
+template <typename K, typename V, typename Compare>
+typename BPlusTree<K, V, Compare>::iterator BPlusTree<K, V, Compare>::upperBound(const K& key) const {
+    BTreeLeaf* leaf = leafFor(key);
+    int slot = countBefore(leaf->keys, leaf->count, key, comp, true);
+    if (slot == leaf->count) {
+        return leaf->next ? iterator(this, leaf->next, 0) : end();
+    }
+    return iterator(this, leaf, slot);
+}
+
+template <typename K, typename V, typename Compare>
+bool BPlusTree<K, V, Compare>::successor(const K& key, K& result) const {
+    iterator it = upperBound(key);
+    if (it == end()) {
+        return false;
+    }
+    result = it.key();
+    return true;
+}
+
+template <typename K, typename V, typename Compare>
+typename BPlusTree<K, V, Compare>::iterator BPlusTree<K, V, Compare>::find(const K& key) const {
+    BTreeLeaf* leaf = leafFor(key);
+    int slot = countBefore(leaf->keys, leaf->count, key, comp, false);
+    if (slot < leaf->count && !comp(key, leaf->keys[slot])) {
+        return iterator(this, leaf, slot);
+    }
+    return end();
+}
+
+template <typename K, typename V, typename Compare>
+pair<typename BPlusTree<K, V, Compare>::iterator, bool> BPlusTree<K, V, Compare>::insert(const K& key, const V& value) {
+    iterator where;
+    bool inserted = false;
+    K separator;
+    BTreeNode* split = insertBelow(root, key, value, where, inserted, separator);
+    if (split) {
+        BTreeInner* grown = new BTreeInner();
+        grown->count = 1;
+        grown->keys[0] = separator;
+        grown->children[0] = root;
+        grown->children[1] = split;
+        root = grown;
+    }
+    if (inserted) {
+        count++;
     }
-    x->right = y;
-    y->parent = x;
+    return make_pair(where, inserted);
 }
 
-void RedBlackTree::insertFixup(Node* z) {
-    while (z && z->parent && z->parent->parent && z->parent->color == RED) {
-        if (z->parent == z->parent->parent->left) {
-            Node* y = z->parent->parent->right;
-            if (y->color == RED) {
-                z->parent->color = BLACK;
-                y->color = BLACK;
-                z->parent->parent->color = RED;
-                z = z->parent->parent;
+// Inserts below x. When x has to split, the new right half is returned and separator is set
+// to the first key that belongs in it.
+template <typename K, typename V, typename Compare>
+typename BPlusTree<K, V, Compare>::BTreeNode*
+BPlusTree<K, V, Compare>::insertBelow(BTreeNode* x, const K& key, const V& value, iterator& where, bool& inserted, K& separator) {
+    if (x->isLeaf) {
+        BTreeLeaf* leaf = static_cast<BTreeLeaf*>(x);
+        int slot = countBefore(leaf->keys, leaf->count, key, comp, false);
+        if (slot < leaf->count && !comp(key, leaf->keys[slot])) {
+            where = iterator(this, leaf, slot);
+            return nullptr;
+        }
+
+        BTreeLeaf* right = nullptr;
+        if (leaf->count == BTREE_NODE_KEYS) {
+            right = new BTreeLeaf();
+            move(leaf->keys + BTREE_MIN_KEYS, leaf->keys + BTREE_NODE_KEYS, right->keys);
+            move(leaf->values + BTREE_MIN_KEYS, leaf->values + BTREE_NODE_KEYS, right->values);
+            right->count = BTREE_NODE_KEYS - BTREE_MIN_KEYS;
+            leaf->count = BTREE_MIN_KEYS;
+            right->next = leaf->next;
+            right->prev = leaf;
+            if (leaf->next) {
+                leaf->next->prev = right;
             }
             else {
-                if (z == z->parent->right) {
-                    z = z->parent;
-                    leftRotate(z);
-                }
-                z->parent->color = BLACK;
-                z->parent->parent->color = RED;
-                rightRotate(z->parent->parent);
+                last = right;
             }
+            leaf->next = right;
+            separator = right->keys[0];
+            if (slot > BTREE_MIN_KEYS) {
+                leaf = right;
+                slot -= BTREE_MIN_KEYS;
+            }
+        }
+
+        move_backward(leaf->keys + slot, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+        move_backward(leaf->values + slot, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+        leaf->keys[slot] = key;
+        leaf->values[slot] = value;
+        leaf->count++;
+        where = iterator(this, leaf, slot);
+        inserted = true;
+        return right;
+    }
+
+    BTreeInner* inner = static_cast<BTreeInner*>(x);
+    int i = countBefore(inner->keys, inner->count, key, comp, true);
+    K childSeparator;
+    BTreeNode* child = insertBelow(inner->children[i], key, value, where, inserted, childSeparator);
+    if (!child) {
+        return nullptr;
+    }
+
+    if (inner->count < BTREE_NODE_KEYS) {
+        move_backward(inner->keys + i, inner->keys + inner->count, inner->keys + inner->count + 1);
+        move_backward(inner->children + i + 1, inner->children + inner->count + 1, inner->children + inner->count + 2);
+        inner->keys[i] = childSeparator;
+        inner->children[i + 1] = child;
+        inner->count++;
+        return nullptr;
+    }
+
+    // Full: lay out all keys and children in order, keep the lower half, push the middle
+    // key up, and move the upper half into a new node.
+    K keys[BTREE_NODE_KEYS + 1];
+    BTreeNode* children[BTREE_NODE_KEYS + 2];
+    move(inner->keys, inner->keys + i, keys);
+    keys[i] = childSeparator;
+    move(inner->keys + i, inner->keys + BTREE_NODE_KEYS, keys + i + 1);
+    copy(inner->children, inner->children + i + 1, children);
+    children[i + 1] = child;
+    copy(inner->children + i + 1, inner->children + BTREE_NODE_KEYS + 1, children + i + 2);
+
+    BTreeInner* right = new BTreeInner();
+    inner->count = BTREE_MIN_KEYS;
+    move(keys, keys + BTREE_MIN_KEYS, inner->keys);
+    copy(children, children + BTREE_MIN_KEYS + 1, inner->children);
+    separator = keys[BTREE_MIN_KEYS];
+    right->count = BTREE_NODE_KEYS - BTREE_MIN_KEYS;
+    move(keys + BTREE_MIN_KEYS + 1, keys + BTREE_NODE_KEYS + 1, right->keys);
+    copy(children + BTREE_MIN_KEYS + 1, children + BTREE_NODE_KEYS + 2, right->children);
+    return right;
+}
+
+template <typename K, typename V, typename Compare>
+size_t BPlusTree<K, V, Compare>::erase(const K& key) {
+    bool erased = false;
+    eraseBelow(root, key, erased);
+    if (!root->isLeaf && root->count == 0) {
+        BTreeInner* oldRoot = static_cast<BTreeInner*>(root);
+        root = oldRoot->children[0];
+        delete oldRoot;
+    }
+    if (!erased) {
+        return 0;
+    }
+    count--;
+    return 1;
+}
+
+// Erases below x and reports whether x is left with too few keys for its parent to keep as is
+template <typename K, typename V, typename Compare>
+bool BPlusTree<K, V, Compare>::eraseBelow(BTreeNode* x, const K& key, bool& erased) {
+    if (x->isLeaf) {
+        BTreeLeaf* leaf = static_cast<BTreeLeaf*>(x);
+        int slot = countBefore(leaf->keys, leaf->count, key, comp, false);
+        if (slot < leaf->count && !comp(key, leaf->keys[slot])) {
+            move(leaf->keys + slot + 1, leaf->keys + leaf->count, leaf->keys + slot);
+            move(leaf->values + slot + 1, leaf->values + leaf->count, leaf->values + slot);
+            leaf->count--;
+            erased = true;
+        }
+        return leaf->count < BTREE_MIN_KEYS;
+    }
+
+    BTreeInner* inner = static_cast<BTreeInner*>(x);
+    int i = countBefore(inner->keys, inner->count, key, comp, true);
+    if (eraseBelow(inner->children[i], key, erased)) {
+        fixChild(inner, i);
+    }
+    return inner->count < BTREE_MIN_KEYS;
+}
+
+// Refills an underfull child by borrowing one entry from a sibling that can spare it, or
+// merges it with a sibling when neither can
+template <typename K, typename V, typename Compare>
+void BPlusTree<K, V, Compare>::fixChild(BTreeInner* parent, int i) {
+    BTreeNode* child = parent->children[i];
+    BTreeNode* left = i > 0 ? parent->children[i - 1] : nullptr;
+    BTreeNode* right = i < parent->count ? parent->children[i + 1] : nullptr;
+
+    if (left && left->count > BTREE_MIN_KEYS) {
+        move_backward(child->keys, child->keys + child->count, child->keys + child->count + 1);
+        if (child->isLeaf) {
+            BTreeLeaf* to = static_cast<BTreeLeaf*>(child);
+            BTreeLeaf* from = static_cast<BTreeLeaf*>(left);
+            move_backward(to->values, to->values + to->count, to->values + to->count + 1);
+            to->keys[0] = from->keys[from->count - 1];
+            to->values[0] = move(from->values[from->count - 1]);
+            parent->keys[i - 1] = to->keys[0];
         }
         else {
-            Node* y = z->parent->parent->left;
-            if (y->color == RED) {
-                z->parent->color = BLACK;
-                y->color = BLACK;
-                z->parent->parent->color = RED;
-                z = z->parent->parent;
-            }
-            else {
-                if (z == z->parent->left) {
-                    z = z->parent;
-                    rightRotate(z);
-                }
-                z->parent->color = BLACK;
-                z->parent->parent->color = RED;
-                leftRotate(z->parent->parent);
-            }
+            BTreeInner* to = static_cast<BTreeInner*>(child);
+            BTreeInner* from = static_cast<BTreeInner*>(left);
+            move_backward(to->children, to->children + to->count + 1, to->children + to->count + 2);
+            to->keys[0] = parent->keys[i - 1];
+            to->children[0] = from->children[from->count];
+            parent->keys[i - 1] = from->keys[from->count - 1];
+        }
+        child->count++;
+        left->count--;
+    }
+    else if (right && right->count > BTREE_MIN_KEYS) {
+        if (child->isLeaf) {
+            BTreeLeaf* to = static_cast<BTreeLeaf*>(child);
+            BTreeLeaf* from = static_cast<BTreeLeaf*>(right);
+            to->keys[to->count] = from->keys[0];
+            to->values[to->count] = move(from->values[0]);
+            move(from->values + 1, from->values + from->count, from->values);
+            move(from->keys + 1, from->keys + from->count, from->keys);
+            parent->keys[i] = from->keys[0];
         }
-        cout << "Root Key: " << root << "Root Color: " << endl;
+        else {
+            BTreeInner* to = static_cast<BTreeInner*>(child);
+            BTreeInner* from = static_cast<BTreeInner*>(right);
+            to->keys[to->count] = parent->keys[i];
+            to->children[to->count + 1] = from->children[0];
+            parent->keys[i] = from->keys[0];
+            move(from->keys + 1, from->keys + from->count, from->keys);
+            copy(from->children + 1, from->children + from->count + 1, from->children);
+        }
+        child->count++;
+        right->count--;
+    }
+    else if (left) {
+        mergeChildren(parent, i - 1);
+    }
+    else {
+        mergeChildren(parent, i);
     }
-    root->color = BLACK;
 }
 
-void RedBlackTree::transplant(Node* u, Node* v) {
-    if (!u->parent) {
-        root = v;
+// Folds children[i + 1] into children[i] and drops their separator from the parent
+template <typename K, typename V, typename Compare>
+void BPlusTree<K, V, Compare>::mergeChildren(BTreeInner* parent, int i) {
+    BTreeNode* left = parent->children[i];
+    BTreeNode* right = parent->children[i + 1];
+
+    if (left->isLeaf) {
+        BTreeLeaf* to = static_cast<BTreeLeaf*>(left);
+        BTreeLeaf* from = static_cast<BTreeLeaf*>(right);
+        move(from->keys, from->keys + from->count, to->keys + to->count);
+        move(from->values, from->values + from->count, to->values + to->count);
+        to->count += from->count;
+        to->next = from->next;
+        if (from->next) {
+            from->next->prev = to;
+        }
+        else {
+            last = to;
+        }
+        delete from;
+    }
+    else {
+        BTreeInner* to = static_cast<BTreeInner*>(left);
+        BTreeInner* from = static_cast<BTreeInner*>(right);
+        to->keys[to->count] = parent->keys[i];
+        move(from->keys, from->keys + from->count, to->keys + to->count + 1);
+        copy(from->children, from->children + from->count + 1, to->children + to->count + 1);
+        to->count += from->count + 1;
+        delete from;
     }
-    else if (u == u->parent->left) {
-        u->parent->left = v;
+
+    move(parent->keys + i + 1, parent->keys + parent->count, parent->keys + i);
+    copy(parent->children + i + 2, parent->children + parent->count + 1, parent->children + i + 1);
+    parent->count--;
+}
+
+// Counts how many times each value appears, building the tree in one pass over the sorted values
+void loadArrayIntoRBTree(const vector<int>& arr, RedBlackTree<int, int> &rb) {
+    cout << "Loading " << arr.size() << " values into the Tree." << endl;
+    vector<int> sorted = arr;
+    parallelSort(sorted, less<int>());
+
+    vector<pair<int, int>> counts;
+    for (int num : sorted) {
+        if (!counts.empty() && counts.back().first == num) {
+            counts.back().second++;
+        }
+        else {
+            counts.push_back(make_pair(num, 1));
+        }
     }
-    if (v) {
-        v->parent = u->parent;
+    rb.build(move(counts), true);
+}
+
+// Average time per operation over keys, in nanoseconds
+template <typename Operation>
+double nanosPerKey(const vector<int>& keys, Operation op) {
+    auto start = chrono::steady_clock::now();
+    for (int key : keys) {
+        op(key);
     }
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / keys.size();
 }
 
-void loadArrayIntoRBTree(const vector<int>& arr, RedBlackTree &rb) {
-    for (int num : arr) {
-        cout << "Inserting " << num << " into the Tree." << endl;
-        rb.insert(num);
+// Compares RedBlackTree with BPlusTree on random int keys and writes one CSV row per size.
+// nodes_per_search is the number of dependent node loads an average lookup makes, which is
+// where the cache misses come from: about log2(n) for the binary tree, the height for the B+ tree.
+void runBenchmarks(ostream& out) {
+    mt19937 gen(5800);
+    const size_t keyCounts[] = {1000, 10000, 100000, 1000000, 4000000};
+
+    out << "tree,key_count,insert_ns,search_ns,batch_search_ns,scan_ns_per_key,erase_ns,nodes_per_search" << endl;
+
+    for (size_t keyCount : keyCounts) {
+        vector<int> keys(keyCount);
+        for (int& key : keys) {
+            key = static_cast<int>(gen());
+        }
+        vector<int> lookups = keys;
+        shuffle(lookups.begin(), lookups.end(), gen);
+        long sink = 0;
+
+        {
+            RedBlackTree<int, int> tree;
+            double insertNs = nanosPerKey(keys, [&](int key) { tree.insert(key, key); });
+            double searchNs = nanosPerKey(lookups, [&](int key) { sink += tree.find(key); });
+            vector<NodeIndex> found(lookups.size());
+            auto batchStart = chrono::steady_clock::now();
+            tree.searchBatch(lookups.data(), lookups.size(), found.data());
+            double batchNs = chrono::duration<double, nano>(chrono::steady_clock::now() - batchStart).count() / lookups.size();
+            sink += found[0];
+            auto start = chrono::steady_clock::now();
+            for (const auto& entry : tree) {
+                sink += entry.second;
+            }
+            double scanNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / tree.size();
+            double depthSum = 0;
+            for (int key : lookups) {
+                depthSum += tree.depth(tree.find(key)) + 1;
+            }
+            double eraseNs = nanosPerKey(lookups, [&](int key) { tree.erase(key); });
+            out << "red_black," << keyCount << "," << insertNs << "," << searchNs << "," << batchNs << "," << scanNs << ","
+                << eraseNs << "," << depthSum / lookups.size() << endl;
+        }
+
+        {
+            BPlusTree<int, int> tree;
+            double insertNs = nanosPerKey(keys, [&](int key) { tree.insert(key, key); });
+            double searchNs = nanosPerKey(lookups, [&](int key) { sink += tree.find(key).value(); });
+            auto start = chrono::steady_clock::now();
+            for (BPlusTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+                sink += it.value();
+            }
+            double scanNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / tree.size();
+            int height = tree.height();
+            double eraseNs = nanosPerKey(lookups, [&](int key) { tree.erase(key); });
+            out << "bplus," << keyCount << "," << insertNs << "," << searchNs << ",," << scanNs << ","
+                << eraseNs << "," << height << endl;
+        }
+
+        volatile long keepSink = sink;
+        (void)keepSink;
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // RedBlackTree --bench [results.csv] compares the trees instead of running the demo
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        if (argc > 2) {
+            ofstream results(argv[2]);
+            runBenchmarks(results);
+        } else {
+            runBenchmarks(cout);
+        }
+        return 0;
+    }
+
     int m;
     cout << "Enter the number of elements to test: ";
     cin >> m;
@@ -272,25 +2571,129 @@ int main() {
         arr.push_back(randomNum);
     }
 
-    RedBlackTree rbTree;
+    RedBlackTree<int, int> rbTree;
 
     loadArrayIntoRBTree(arr, rbTree);
 
     cout << "Print In Line Walk: ";
     rbTree.inlineWalk(rbTree.root);
 
-    RedBlackTree rbTree2;
+    RedBlackTree<int, int> rbTree2;
 
     cout << "\n\nPrint Test In LIne Walk: ";
 
-    rbTree2.insert(11);
-    rbTree2.insert(7);
-    rbTree2.insert(15);
-    rbTree2.insert(5);
+    rbTree2.insert(11, 0);
+    rbTree2.insert(7, 0);
+    rbTree2.insert(15, 0);
+    rbTree2.insert(5, 0);
 
     rbTree2.inlineWalk(rbTree2.root);
 
-    cout << "\n Successor 11: " << rbTree2.successor(rbTree2.search(rbTree2.root, 11))->key;
+    cout << "\n Successor 11: " << rbTree2.key(rbTree2.successor(rbTree2.search(rbTree2.root, 11)));
+
+    if (!rbTree.empty()) {
+        cout << "\n Median: " << rbTree.key(rbTree.select(rbTree.size() / 2));
+        cout << "\n Distinct values below 50: " << rbTree.rank(50);
+    }
+    cout << "\n Counts in [20, 60): ";
+    for (const auto& entry : rbTree.range(20, 60)) {
+        cout << entry.first << "x" << entry.second << " ";
+    }
+
+    RedBlackTree<int, int> evens;
+    RedBlackTree<int, int> multiplesOfThree;
+    vector<pair<int, int>> entries;
+    for (int i = 0; i < 30; i += 2) {
+        entries.push_back(make_pair(i, 0));
+    }
+    evens.build(entries, true);
+    entries.clear();
+    for (int i = 0; i < 30; i += 3) {
+        entries.push_back(make_pair(i, 0));
+    }
+    multiplesOfThree.build(entries, true);
+
+    evens.subtract(multiplesOfThree);
+    cout << "\n\nEvens not divisible by 3: ";
+    for (const auto& entry : evens) {
+        cout << entry.first << " ";
+    }
+    evens.unionWith(move(multiplesOfThree));
+    cout << "\n Joined with multiples of 3: ";
+    for (const auto& entry : evens) {
+        cout << entry.first << " ";
+    }
+
+    // readers scan while a writer inserts; every scan sees a complete, consistent tree
+    ConcurrentRedBlackTree<int, int> shared;
+    atomic<bool> writing(true);
+    vector<thread> readers;
+    for (int r = 0; r < 4; r++) {
+        readers.emplace_back([&]() {
+            long seen = 0;
+            while (writing.load()) {
+                shared.range(0, 1000, [&](int, int) { seen++; });
+            }
+        });
+    }
+    for (int i = 0; i < 1000; i++) {
+        shared.insert(i, i * i);
+    }
+    writing.store(false);
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    int square = 0;
+    shared.search(30, square);
+    cout << "\n\nConcurrent tree size: " << shared.size() << ", 30 squared: " << square;
+
+    // round trip the counts through a file, then query the file in place
+    rbTree.save("counts.rbt");
+    RedBlackTree<int, int> reloaded;
+    reloaded.load("counts.rbt");
+    cout << "\n\nReloaded " << reloaded.size() << " distinct values";
+    {
+        RedBlackTreeView<int, int> view("counts.rbt");
+        cout << "\n Mapped view has " << view.size() << " values" << (view.verify() ? "" : " (corrupt)") << ", smallest: ";
+        if (view.min() != NIL) {
+            cout << view.key(view.min()) << "x" << view.value(view.min());
+        }
+    }
+    remove("counts.rbt");
+
+    PersistentRedBlackTree<int, string> versions;
+    versions.insert(1, "one");
+    versions.insert(2, "two");
+    PersistentRedBlackTree<int, string> before = versions.snapshot();
+    versions.insert(3, "three");
+    versions.erase(1);
+    cout << "\n\nSnapshot: ";
+    before.forEach([](int key, const string& name) { cout << key << "=" << name << " "; });
+    cout << "\n Current: ";
+    versions.forEach([](int key, const string& name) { cout << key << "=" << name << " "; });
+
+    BPlusTree<int, int> wide;
+    for (int i = 0; i < 1000; i++) {
+        wide.insert(i * 7 % 1000, i);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        wide.erase(i);
+    }
+    int after = 0;
+    wide.successor(500, after);
+    cout << "\n\nB+ tree size: " << wide.size() << ", height: " << wide.height() << ", successor of 500: " << after;
+
+    RedBlackTree<string, unique_ptr<string>, less<>> names;
+    names.tryEmplace("carol", new string("third"));
+    names.tryEmplace("alice", new string("first"));
+    names.emplace("bob", unique_ptr<string>(new string("second")));
+
+    cout << "\n\nOrdered Names: ";
+    for (const auto& entry : names) {
+        cout << entry.first << "=" << *entry.second << " ";
+    }
+    // less<> lets a string_view look a key up without building a string
+    cout << "\n Find bob: " << *names.value(names.find(string_view("bob"))) << endl;
 
     return 0;
-}
\ No newline at end of file
+}